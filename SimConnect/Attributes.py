@@ -683,7 +683,11 @@ class SimConnectDll(object):
 		#   DWORD * pcbData);
 		self.GetNextDispatch = self.SimConnect.SimConnect_GetNextDispatch
 		self.GetNextDispatch.restype = HRESULT
-		self.GetNextDispatch.argtypes = []
+		self.GetNextDispatch.argtypes = [
+			HANDLE,
+			POINTER(POINTER(SIMCONNECT_RECV)),
+			POINTER(DWORD),
+		]
 
 		# SIMCONNECTAPI SimConnect_RequestResponseTimes(
 		#   HANDLE hSimConnect,
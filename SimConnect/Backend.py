@@ -0,0 +1,47 @@
+import os
+import sys
+from .Enum import *
+
+
+# ----------------------------------------------------------------------------
+#        Backends
+#
+# A backend is the object SimConnect keeps as self.dll. It exposes the
+# client ID enums (EventID, DATA_DEFINITION_ID, DATA_REQUEST_ID, ...), a
+# DispatchProc callback type and the SimConnect_* functions without their
+# prefix (Open, AddToDataDefinition, RequestDataOnSimObject, GetNextDispatch,
+# ...), each returning an HRESULT. Two implementations exist:
+#
+#   SimConnectDll      Attributes.py, the real SimConnect.dll through ctypes.
+#   FakeSimConnectDll  FakeSim.py, an in-process scripted flight model.
+#
+# The DLL is the default everywhere. The fake is opt-in only, through
+# SIMCONNECT_BACKEND=fake or SimConnect(backend="fake") (tests, CI), so a
+# host without the sim never silently serves a scripted flight as real data.
+# ----------------------------------------------------------------------------
+
+BACKEND_ENV = "SIMCONNECT_BACKEND"
+
+
+def default_backend():
+	backend = os.environ.get(BACKEND_ENV)
+	if backend:
+		return backend.lower()
+	return "dll"
+
+
+def load_backend(library_path, backend=None):
+	if backend is None:
+		backend = default_backend()
+	if backend == "fake":
+		from .FakeSim import FakeSimConnectDll
+		LOGGER.info("Using the in-process fake SimConnect backend.")
+		return FakeSimConnectDll(library_path)
+	if backend == "dll":
+		if sys.platform != "win32":
+			raise OSError(
+				"SimConnect.dll needs Windows; set %s=fake to run against the in-process fake sim." % (BACKEND_ENV)
+			)
+		from .Attributes import SimConnectDll
+		return SimConnectDll(library_path)
+	raise ValueError("Unknown SimConnect backend: %s" % (backend))
@@ -0,0 +1,244 @@
+import threading
+from .Enum import *
+from .Constants import *
+from .SimConnect import SimConnect
+from .Supervisor import ConnectionSupervisor
+from .RequestList import AircraftRequests
+from .EventList import AircraftEvents
+from .EventListener import EventListener
+from .SimState import SimStateTracker
+
+
+# Fastest first; a key pushed at a faster period satisfies every slower one.
+_PERIOD_RANK = {
+	SIMCONNECT_PERIOD.SIMCONNECT_PERIOD_SIM_FRAME: 0,
+	SIMCONNECT_PERIOD.SIMCONNECT_PERIOD_VISUAL_FRAME: 1,
+	SIMCONNECT_PERIOD.SIMCONNECT_PERIOD_SECOND: 2,
+}
+
+
+class Subscription(object):
+	"""One consumer's pushed keys, read back from the shared store."""
+
+	def __init__(self, _broker, consumer, keys, period, changed):
+		self.broker = _broker
+		self.consumer = consumer
+		self.keys = list(keys)
+		self.period = period
+		self.changed = changed
+
+	def latest(self):
+		# Current store frame, or None before any of the keys was pushed.
+		frame = self.broker.sm.store.frame()
+		for key in self.keys:
+			if key in frame:
+				return frame
+		return None
+
+	def get(self, key, default=None):
+		return self.broker.sm.store.get(key, default)
+
+	def refresh(self):
+		# Read the groups holding our keys now instead of waiting for their
+		# next push; the answers are published to the store like one.
+		groups = self.broker.groups_for(self.keys)
+		if groups:
+			self.broker.sm.get_many(groups)
+		return self.latest()
+
+	def cancel(self):
+		self.broker.unsubscribe(self.consumer)
+
+
+class ConnectionBroker(object):
+	"""One SimConnect connection shared by every subsystem of the process.
+
+	The bridge and the web server each used to open their own connection
+	and define the same simvars twice. The broker owns the connection, its
+	supervisor, one AircraftRequests, one AircraftEvents, one EventListener
+	and one SimStateTracker, and merges what each consumer asks for:
+
+	  requests(max_age, consumer)
+	                      polled reads are cached for the smallest max_age
+	                      any consumer asked for; asking again replaces
+	                      that consumer's age.
+	  subscribe(...)      every key is pushed at the fastest period any
+	                      consumer needs, and with changed=True only if
+	                      every consumer accepts that. Keys sharing a merged
+	                      (period, changed) pair form one DefinitionGroup.
+
+	Everything lands in the one sm.store. Use get_broker() for the process
+	instance.
+	"""
+
+	def __init__(self, _sm=None, timeout=10, min_retry=2, max_retry=30):
+		if _sm is None:
+			_sm = SimConnect(auto_connect=False)
+		self.sm = _sm
+		self.supervisor = ConnectionSupervisor(
+			_sm,
+			on_connect=self._connected,
+			on_disconnect=self._disconnected,
+			timeout=timeout,
+			min_retry=min_retry,
+			max_retry=max_retry,
+		)
+		self.connect_callbacks = []
+		self.disconnect_callbacks = []
+		self.subscriptions = {}
+		self.groups = {}
+		self.ages = {}
+		self._aq = None
+		self._ae = None
+		self._listener = None
+		self._state = None
+		self._lock = threading.RLock()
+
+	def configure(self, _sm=None, timeout=None, min_retry=None, max_retry=None):
+		# Apply connection settings to a broker that already exists.
+		if _sm is not None and _sm is not self.sm:
+			LOGGER.warning("Broker already owns a SimConnect instance; ignoring the one passed in.")
+		supervisor = self.supervisor
+		if timeout is not None:
+			supervisor.timeout = timeout
+		if min_retry is not None:
+			supervisor.min_retry = min_retry
+		if max_retry is not None:
+			supervisor.max_retry = max_retry
+		supervisor.retry = min(max(supervisor.retry, supervisor.min_retry), supervisor.max_retry)
+
+	def start(self):
+		self.supervisor.start()
+
+	def stop(self):
+		self.supervisor.stop()
+
+	@property
+	def connected(self):
+		return self.supervisor.connected.is_set()
+
+	def on_connect(self, callback):
+		self.connect_callbacks.append(callback)
+
+	def on_disconnect(self, callback):
+		self.disconnect_callbacks.append(callback)
+
+	def requests(self, max_age=None, consumer=None):
+		# max_age in ms, kept per consumer; the shared cache age is the
+		# smallest one currently asked for.
+		with self._lock:
+			if max_age is not None:
+				self.ages[consumer] = max_age
+			age = min(self.ages.values()) if self.ages else 10
+			if self._aq is None:
+				self._aq = AircraftRequests(self.sm, _time=age)
+			elif age != self._aq.time:
+				self._aq.set_time(age)
+			return self._aq
+
+	def events(self, warm=None):
+		# warm: event names to map in one batch on every connect.
+		with self._lock:
+			if self._ae is None:
+				self._ae = AircraftEvents(self.sm)
+			if warm:
+				self._ae.warm(warm)
+			return self._ae
+
+	def listener(self):
+		# Shared EventListener; its callbacks survive reconnects.
+		with self._lock:
+			if self._listener is None:
+				self._listener = EventListener(self.sm)
+			return self._listener
+
+	def state(self):
+		# Shared SimStateTracker.
+		with self._lock:
+			if self._state is None:
+				self._state = SimStateTracker(self.sm)
+			return self._state
+
+	def subscribe(self, consumer, keys, period=SIMCONNECT_PERIOD.SIMCONNECT_PERIOD_SECOND, changed=False):
+		# Replaces any earlier subscription of the same consumer.
+		if period not in _PERIOD_RANK:
+			raise ValueError("Unsupported subscription period: %s" % (period))
+		with self._lock:
+			subscription = Subscription(self, consumer, keys, period, changed)
+			self.subscriptions[consumer] = subscription
+			if self.connected:
+				self._apply()
+			return subscription
+
+	def unsubscribe(self, consumer):
+		with self._lock:
+			if self.subscriptions.pop(consumer, None) is not None and self.connected:
+				self._apply()
+
+	def merged(self):
+		# {(period, changed): [keys]} satisfying every consumer.
+		need = {}
+		for subscription in self.subscriptions.values():
+			rank = _PERIOD_RANK[subscription.period]
+			for key in subscription.keys:
+				(best, changed) = need.get(key, (rank, True))
+				need[key] = (min(best, rank), changed and subscription.changed)
+		periods = {rank: period for period, rank in _PERIOD_RANK.items()}
+		buckets = {}
+		for key, (rank, changed) in need.items():
+			buckets.setdefault((periods[rank], changed), []).append(key)
+		return buckets
+
+	def groups_for(self, keys):
+		keys = set(keys)
+		with self._lock:
+			return [group for group in self.groups.values() if keys.intersection(group.keys)]
+
+	def _apply(self):
+		# Keep groups whose key set is unchanged, rebuild the others.
+		aq = self.requests()
+		buckets = self.merged()
+		for bucket, group in list(self.groups.items()):
+			if sorted(buckets.get(bucket, [])) != sorted(group.keys + group.disabled):
+				group.release()
+				del self.groups[bucket]
+		for (period, changed), keys in buckets.items():
+			if (period, changed) not in self.groups:
+				self.groups[(period, changed)] = aq.subscribe(keys, period, changed)
+
+	def _connected(self, sm):
+		with self._lock:
+			# The session replays existing groups; only add what is missing.
+			self._apply()
+			if self._ae is not None:
+				self._ae.warm()
+			if self._listener is not None:
+				self._listener.attach()
+			if self._state is not None:
+				self._state.update()
+		for callback in list(self.connect_callbacks):
+			callback(sm)
+
+	def _disconnected(self, sm):
+		if self._state is not None:
+			self._state.update()
+		for callback in list(self.disconnect_callbacks):
+			callback(sm)
+
+
+_broker = None
+_broker_lock = threading.Lock()
+
+
+def get_broker(**kwargs):
+	# Process-wide broker, created and started on first use. Consumers that
+	# just share it (the server) pass nothing; settings passed after it was
+	# created (the bridge's retry policy) still reach it through configure().
+	global _broker
+	with _broker_lock:
+		if _broker is None:
+			_broker = ConnectionBroker(**kwargs)
+			_broker.start()
+		elif kwargs:
+			_broker.configure(**kwargs)
+		return _broker
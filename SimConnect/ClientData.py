@@ -0,0 +1,228 @@
+from SimConnect import *
+import struct
+from .Enum import *
+from .Constants import *
+from .DataLayout import DATA_OFFSET
+from .DefinitionGroup import Snapshot
+
+
+# ----------------------------------------------------------------------------
+#        Client Data Area channel
+#
+# Protocol shared with the in-sim WASM companion module:
+#
+#   <prefix>.Registry  written by us, read by the companion (ON_SET).
+#       One record per SetClientData: generation, index, count, expression.
+#       expression is calculator code such as b"(L:A32NX_ELEC_AC_1_BUS_IS_POWERED)".
+#       A new generation invalidates every previously registered index.
+#   <prefix>.Values    written by the companion, read by us every frame.
+#       generation, count, then count FLOAT64 values in registry order.
+#
+# Each area is limited to SIMCONNECT_CLIENTDATA_MAX_SIZE bytes, which puts
+# the ceiling at 1023 values per channel.
+# ----------------------------------------------------------------------------
+
+CLIENTDATA_MAX_SIZE = 8192
+
+
+class ClientDataChannel(object):
+	"""Bulk reads of L:vars and other calculator expressions in one message.
+
+	register() hands the expressions to the companion module, which
+	evaluates them every frame and publishes the results as one packed
+	block. decode() reads that block in place and publishes it into sm.store
+	under the registered names, exactly like a subscribed DefinitionGroup.
+	"""
+
+	REGISTRY = struct.Struct('<III256s')
+	HEADER = struct.Struct('<II')
+	MAX_VALUES = (CLIENTDATA_MAX_SIZE - HEADER.size) // 8
+
+	def __init__(self, _sm, _prefix=b"OpenSquawk", period=SIMCONNECT_CLIENT_DATA_PERIOD.SIMCONNECT_CLIENT_DATA_PERIOD_VISUAL_FRAME):
+		self.sm = _sm
+		self.prefix = _prefix
+		self.period = period
+		self.keys = []
+		self.expressions = []
+		self.generation = 0
+		self.outData = None
+		self.LastData = 0
+		self.REGISTRY_ID = None
+		self.VALUES_ID = None
+		self.REGISTRY_DEFINITION_ID = None
+		self.VALUES_DEFINITION_ID = None
+		self.DATA_REQUEST_ID = None
+		self.defined = False
+		self._values = None
+		self._keys = ()
+		self._index = {}
+
+	def _deff_test(self):
+		if self.defined is True:
+			return True
+		if self.REGISTRY_ID is None:
+			self.REGISTRY_ID = self.sm.client_data_ids.acquire()
+			self.VALUES_ID = self.sm.client_data_ids.acquire()
+			self.REGISTRY_DEFINITION_ID = self.sm.client_def_ids.acquire()
+			self.VALUES_DEFINITION_ID = self.sm.client_def_ids.acquire()
+			self.DATA_REQUEST_ID = self.sm.new_request_id()
+			self.sm.Requests[self.DATA_REQUEST_ID.value] = self
+
+		for (name, ID) in ((b".Registry", self.REGISTRY_ID), (b".Values", self.VALUES_ID)):
+			err = self.sm.dll.MapClientDataNameToID(self.sm.hSimConnect, self.prefix + name, ID.value)
+			self.sm.track(self, name)
+			if not self.sm.IsHR(err, 0):
+				LOGGER.error("Client data map " + str(self.prefix + name))
+				return False
+
+		# The registry is ours to write; it may already exist if the
+		# companion created it first, so a failure here is not fatal.
+		self.sm.dll.CreateClientData(
+			self.sm.hSimConnect,
+			self.REGISTRY_ID.value,
+			self.REGISTRY.size,
+			SIMCONNECT_CREATE_CLIENT_DATA_FLAG.SIMCONNECT_CREATE_CLIENT_DATA_FLAG_DEFAULT,
+		)
+		err = self.sm.dll.AddToClientDataDefinition(
+			self.sm.hSimConnect,
+			self.REGISTRY_DEFINITION_ID.value,
+			0,
+			self.REGISTRY.size,
+			0,
+			SIMCONNECT_UNUSED,
+		)
+		self.sm.track(self, b".Registry")
+		if not self.sm.IsHR(err, 0):
+			LOGGER.error("Client data def " + str(self.prefix + b".Registry"))
+			return False
+
+		self.defined = True
+		return True
+
+	def _define_values(self):
+		# The values definition covers exactly the registered expressions.
+		self.sm.dll.ClearClientDataDefinition(self.sm.hSimConnect, self.VALUES_DEFINITION_ID.value)
+		err = self.sm.dll.AddToClientDataDefinition(
+			self.sm.hSimConnect,
+			self.VALUES_DEFINITION_ID.value,
+			0,
+			self.HEADER.size + 8 * len(self.keys),
+			0,
+			SIMCONNECT_UNUSED,
+		)
+		self.sm.track(self, b".Values")
+		if not self.sm.IsHR(err, 0):
+			return False
+		err = self.sm.dll.RequestClientData(
+			self.sm.hSimConnect,
+			self.VALUES_ID.value,
+			self.DATA_REQUEST_ID.value,
+			self.VALUES_DEFINITION_ID.value,
+			self.period,
+			SIMCONNECT_CLIENT_DATA_REQUEST_FLAG.SIMCONNECT_CLIENT_DATA_REQUEST_FLAG_CHANGED,
+			0,
+			0,
+			0,
+		)
+		self.sm.track(self)
+		return self.sm.IsHR(err, 0)
+
+	def register(self, _vars):
+		# _vars maps store keys to calculator expressions, or is a list of
+		# L:var names used as both, e.g. ["L:A32NX_AUTOPILOT_1_ACTIVE"].
+		if not isinstance(_vars, dict):
+			_vars = {name: name for name in _vars}
+		if len(_vars) > self.MAX_VALUES:
+			raise ValueError("At most %d client data values per channel." % (self.MAX_VALUES))
+		if not self._deff_test():
+			return False
+
+		self.generation += 1
+		self.keys = list(_vars.keys())
+		self.expressions = [self._expression(expr) for expr in _vars.values()]
+		self._values = struct.Struct('<%dd' % (len(self.keys)))
+		self._keys = tuple(self.keys)
+		self._index = {key: i for i, key in enumerate(self._keys)}
+		self.outData = None
+		return self._send_registry()
+
+	def replay(self):
+		# Hand the same registration to the companion on a new connection.
+		if not self._deff_test():
+			return False
+		if not self.keys:
+			return True
+		return self._send_registry()
+
+	def _send_registry(self):
+		record = create_string_buffer(self.REGISTRY.size)
+		for index, expression in enumerate(self.expressions):
+			self.REGISTRY.pack_into(record, 0, self.generation, index, len(self.expressions), expression)
+			err = self.sm.dll.SetClientData(
+				self.sm.hSimConnect,
+				self.REGISTRY_ID.value,
+				self.REGISTRY_DEFINITION_ID.value,
+				SIMCONNECT_CLIENT_DATA_SET_FLAG.SIMCONNECT_CLIENT_DATA_SET_FLAG_DEFAULT,
+				0,
+				self.REGISTRY.size,
+				cast(record, c_void_p),
+			)
+			self.sm.track(self, self.keys[index])
+			if not self.sm.IsHR(err, 0):
+				LOGGER.error("Client data register " + str(expression))
+				return False
+		return self._define_values()
+
+	def _expression(self, expr):
+		if isinstance(expr, str):
+			expr = expr.encode()
+		if not expr.startswith(b"("):
+			# Bare L:var name, read in its default units.
+			expr = b"(" + expr + b")"
+		return expr
+
+	def decode(self, ObjData):
+		(generation, count) = self.HEADER.unpack_from(ObjData, DATA_OFFSET)
+		if generation != self.generation or count != len(self.keys):
+			# Block still laid out for a previous registration.
+			return
+		values = self._values.unpack_from(ObjData, DATA_OFFSET + self.HEADER.size)
+		snapshot = Snapshot(self._keys, values, millis(), self._index)
+		self.outData = snapshot
+		self.LastData = snapshot.timestamp
+		self.sm.store.publish(snapshot, self)
+
+	def get(self, key, default=None):
+		if self.outData is None:
+			return default
+		return self.outData.get(key, default)
+
+	def on_exception(self, exception, datum):
+		LOGGER.warning("%s: in client data %s" % (exception.name, datum))
+
+	def release(self):
+		if self.REGISTRY_ID is None:
+			return
+		self.sm.dll.RequestClientData(
+			self.sm.hSimConnect,
+			self.VALUES_ID.value,
+			self.DATA_REQUEST_ID.value,
+			self.VALUES_DEFINITION_ID.value,
+			SIMCONNECT_CLIENT_DATA_PERIOD.SIMCONNECT_CLIENT_DATA_PERIOD_NEVER,
+			0,
+			0,
+			0,
+			0,
+		)
+		for ID in (self.REGISTRY_DEFINITION_ID, self.VALUES_DEFINITION_ID):
+			self.sm.dll.ClearClientDataDefinition(self.sm.hSimConnect, ID.value)
+			self.sm.client_def_ids.release(ID)
+		self.sm.client_data_ids.release(self.REGISTRY_ID)
+		self.sm.client_data_ids.release(self.VALUES_ID)
+		self.sm.release_request_id(self.DATA_REQUEST_ID)
+		self.REGISTRY_ID = None
+		self.VALUES_ID = None
+		self.REGISTRY_DEFINITION_ID = None
+		self.VALUES_DEFINITION_ID = None
+		self.DATA_REQUEST_ID = None
+		self.defined = False
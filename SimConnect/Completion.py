@@ -0,0 +1,40 @@
+import threading
+import time
+
+
+class Completion(object):
+	"""Completion signal owned by one request ID.
+
+	request_data arms it before the request goes out and the dispatch
+	thread sets it as soon as the matching SIMOBJECT_DATA is decoded, so
+	readers wake on arrival instead of polling.
+	"""
+
+	def __init__(self):
+		self._event = threading.Event()
+
+	def arm(self):
+		self._event.clear()
+
+	def set(self):
+		self._event.set()
+
+	def done(self):
+		return self._event.is_set()
+
+	def wait(self, timeout=None):
+		return self._event.wait(timeout)
+
+
+def wait_all(completions, timeout=None):
+	# Wait until every completion is set or the shared deadline passes.
+	deadline = None
+	if timeout is not None:
+		deadline = time.monotonic() + timeout
+	for completion in completions:
+		remaining = None
+		if deadline is not None:
+			remaining = max(0, deadline - time.monotonic())
+		if not completion.wait(remaining):
+			return False
+	return True
@@ -0,0 +1,64 @@
+import struct
+from .Enum import *
+
+# Byte offset of dwData inside SIMCONNECT_RECV_SIMOBJECT_DATA (and the
+# client data message, which shares its layout).
+DATA_OFFSET = SIMCONNECT_RECV_SIMOBJECT_DATA.dwData.offset
+
+# struct codes for the fixed-size datum types; SimConnect packs datums
+# back to back without padding, hence the '<' prefix.
+DATATYPE_FORMATS = {
+	SIMCONNECT_DATATYPE.SIMCONNECT_DATATYPE_INT32: 'i',
+	SIMCONNECT_DATATYPE.SIMCONNECT_DATATYPE_INT64: 'q',
+	SIMCONNECT_DATATYPE.SIMCONNECT_DATATYPE_FLOAT32: 'f',
+	SIMCONNECT_DATATYPE.SIMCONNECT_DATATYPE_FLOAT64: 'd',
+	SIMCONNECT_DATATYPE.SIMCONNECT_DATATYPE_STRING8: '8s',
+	SIMCONNECT_DATATYPE.SIMCONNECT_DATATYPE_STRING32: '32s',
+	SIMCONNECT_DATATYPE.SIMCONNECT_DATATYPE_STRING64: '64s',
+	SIMCONNECT_DATATYPE.SIMCONNECT_DATATYPE_STRING128: '128s',
+	SIMCONNECT_DATATYPE.SIMCONNECT_DATATYPE_STRING256: '256s',
+	SIMCONNECT_DATATYPE.SIMCONNECT_DATATYPE_STRING260: '260s',
+}
+
+
+def is_string_type(datatype):
+	return DATATYPE_FORMATS.get(datatype, '').endswith('s')
+
+
+class DataLayout(object):
+	"""Precompiled layout of one data definition.
+
+	Decodes a receive buffer in place with struct.unpack_from: the ctypes
+	message is read through the buffer protocol without copying. decode()
+	returns a fresh tuple per message, decode_into() fills a caller-owned
+	list that is reused across messages.
+	"""
+
+	def __init__(self, datatypes):
+		self.datatypes = list(datatypes)
+		fmt = '<'
+		for datatype in self.datatypes:
+			if datatype not in DATATYPE_FORMATS:
+				raise ValueError("Unsupported datum type: %s" % (datatype))
+			fmt += DATATYPE_FORMATS[datatype]
+		self.struct = struct.Struct(fmt)
+		self.size = self.struct.size
+		self.strings = [i for i, datatype in enumerate(self.datatypes) if is_string_type(datatype)]
+
+	def decode(self, buffer, offset=DATA_OFFSET):
+		values = self.struct.unpack_from(buffer, offset)
+		if not self.strings:
+			return values
+		return tuple(self.decode_into(buffer, [None] * len(values), offset))
+
+	def decode_into(self, buffer, values, offset=DATA_OFFSET):
+		values[:] = self.struct.unpack_from(buffer, offset)
+		for i in self.strings:
+			raw = values[i]
+			end = raw.find(b'\0')
+			if end >= 0:
+				values[i] = raw[:end]
+		return values
+
+	def pack_into(self, buffer, values, offset=0):
+		self.struct.pack_into(buffer, offset, *values)
@@ -0,0 +1,103 @@
+import threading
+import time
+
+
+class Frame(object):
+	"""One published state of the store; never modified after publish.
+
+	snapshots maps each publishing source (a DefinitionGroup, a
+	ClientDataChannel...) to its latest Snapshot, and owners maps every key
+	to the source whose snapshot holds it.
+	"""
+
+	__slots__ = ("snapshots", "owners", "seq")
+
+	def __init__(self, snapshots, owners, seq):
+		self.snapshots = snapshots
+		self.owners = owners
+		self.seq = seq
+
+	def get(self, key, default=None):
+		source = self.owners.get(key)
+		if source is None:
+			return default
+		return self.snapshots[source].get(key, default)
+
+	def __contains__(self, key):
+		return key in self.owners
+
+	def stamp(self, key):
+		# Timestamp (ms) of the snapshot holding key, None if never pushed.
+		source = self.owners.get(key)
+		if source is None:
+			return None
+		return self.snapshots[source].timestamp
+
+	def json(self, keys=None):
+		if keys is None:
+			keys = self.owners
+		return {key: self.get(key) for key in keys}
+
+
+class DataStore(object):
+	"""Latest pushed value of every subscribed simvar, keyed by catalog name.
+
+	Subscribed DefinitionGroups publish each decoded Snapshot here from the
+	dispatch thread, so readers never pay a SimConnect round-trip.
+
+	Publishing is copy-on-write per source: the next Frame shares every
+	other source's snapshot and only swaps in the publisher's, so a publish
+	costs O(sources), not O(keys). The key index is copied only when a
+	source's key set changes. seq counts the swaps. Readers load
+	self._frame once and never lock, so they can neither stall the
+	dispatcher nor see half of a publish; use frame() to read several keys
+	from the same state.
+	"""
+
+	def __init__(self):
+		self._frame = Frame({}, {}, 0)
+		# source -> keys tuple its owners entries were built from.
+		self._indexed = {}
+		# Serialises writers only; readers never take it.
+		self._lock = threading.Lock()
+
+	@property
+	def seq(self):
+		return self._frame.seq
+
+	def frame(self):
+		return self._frame
+
+	def publish(self, snapshot, source):
+		with self._lock:
+			frame = self._frame
+			snapshots = dict(frame.snapshots)
+			snapshots[source] = snapshot
+			owners = frame.owners
+			if self._indexed.get(source) is not snapshot.keys:
+				owners = dict(owners)
+				owners.update(dict.fromkeys(snapshot.keys, source))
+				self._indexed[source] = snapshot.keys
+				# Drop sources that no longer own any key, e.g. released groups.
+				live = set(owners.values())
+				snapshots = {s: snap for s, snap in snapshots.items() if s in live}
+				self._indexed = {s: keys for s, keys in self._indexed.items() if s in live}
+			self._frame = Frame(snapshots, owners, frame.seq + 1)
+
+	def get(self, key, default=None):
+		return self._frame.get(key, default)
+
+	def age(self, key):
+		# Milliseconds since the value was last pushed, None if never.
+		stamp = self._frame.stamp(key)
+		if stamp is None:
+			return None
+		return int(round(time.time() * 1000)) - stamp
+
+	def json(self, keys=None):
+		return self._frame.json(keys)
+
+	def clear(self):
+		with self._lock:
+			self._indexed = {}
+			self._frame = Frame({}, {}, self._frame.seq + 1)
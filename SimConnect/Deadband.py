@@ -0,0 +1,66 @@
+# ----------------------------------------------------------------------------
+#        Epsilon deadbands
+#
+# fEpsilon passed to AddToDataDefinition: with the CHANGED request flag the
+# sim only sends a datum once it moved by more than this since the last
+# send. Values are in the units of the AircraftRequests catalog entry and
+# are keyed by catalog name without the ":index" suffix, so one entry covers
+# every engine/radio index.
+# ----------------------------------------------------------------------------
+
+DEFAULT_EPSILON = {
+	# Position, ~1 m
+	"PLANE_LATITUDE": 0.00001,
+	"PLANE_LONGITUDE": 0.00001,
+	"PLANE_ALTITUDE": 1.0,
+	"INDICATED_ALTITUDE": 1.0,
+	"PLANE_ALT_ABOVE_GROUND": 1.0,
+	# Attitude (Radians), ~0.06 degrees
+	"PLANE_PITCH_DEGREES": 0.001,
+	"PLANE_BANK_DEGREES": 0.001,
+	"PLANE_HEADING_DEGREES_TRUE": 0.001,
+	"PLANE_HEADING_DEGREES_MAGNETIC": 0.001,
+	"PLANE_HEADING_DEGREES_GYRO": 0.001,
+	"HEADING_INDICATOR": 0.001,
+	"MAGNETIC_COMPASS": 0.1,
+	# Speeds
+	"AIRSPEED_INDICATED": 0.1,
+	"AIRSPEED_TRUE": 0.1,
+	"GROUND_VELOCITY": 0.1,
+	"AIRSPEED_MACH": 0.001,
+	"VERTICAL_SPEED": 10.0,
+	"VELOCITY_WORLD_Y": 0.1,
+	"AMBIENT_WIND_VELOCITY": 0.5,
+	"AMBIENT_WIND_DIRECTION": 1.0,
+	# Engines
+	"TURB_ENG_N1": 0.1,
+	"TURB_ENG_N2": 0.1,
+	"GENERAL_ENG_RPM": 5.0,
+	"GENERAL_ENG_PCT_MAX_RPM": 0.1,
+	"GENERAL_ENG_THROTTLE_LEVER_POSITION": 0.1,
+	"GENERAL_ENG_OIL_TEMPERATURE": 0.5,
+	"ENG_FUEL_FLOW_GPH": 0.1,
+	# Fuel
+	"FUEL_TOTAL_QUANTITY": 0.1,
+	"FUEL_TOTAL_QUANTITY_WEIGHT": 0.5,
+	# Surfaces (Percent Over 100)
+	"ELEVATOR_TRIM_PCT": 0.001,
+	"AILERON_TRIM_PCT": 0.001,
+	"RUDDER_TRIM_PCT": 0.001,
+	"FLAPS_HANDLE_PERCENT": 0.001,
+}
+
+
+def epsilon_for(key, overrides=None):
+	# Per-consumer overrides win over the defaults; an exact key such as
+	# "TURB_ENG_N1:2" wins over its base name. Unknown keys get 0, i.e.
+	# every change is reported.
+	base = key.split(":", 1)[0]
+	for table in (overrides, DEFAULT_EPSILON):
+		if not table:
+			continue
+		if key in table:
+			return table[key]
+		if base in table:
+			return table[base]
+	return 0
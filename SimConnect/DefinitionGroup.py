@@ -0,0 +1,393 @@
+from SimConnect import *
+import struct
+import threading
+from .Enum import *
+from .Constants import *
+from .DataLayout import DataLayout, DATATYPE_FORMATS, is_string_type
+from .Deadband import epsilon_for
+
+
+# Exceptions raised by AddToDataDefinition for a datum the sim won't serve.
+DATUM_REJECTED = (
+	SIMCONNECT_EXCEPTION.SIMCONNECT_EXCEPTION_NAME_UNRECOGNIZED,
+	SIMCONNECT_EXCEPTION.SIMCONNECT_EXCEPTION_INVALID_DATA_TYPE,
+)
+
+
+class Snapshot(object):
+	"""Values of one DefinitionGroup response, addressed by field key.
+
+	A snapshot is never modified once published: every response builds a
+	new one, so a reader holding it sees a single frame even while the
+	dispatch thread decodes the next.
+	"""
+
+	__slots__ = ("keys", "values", "timestamp", "_index")
+
+	def __init__(self, _keys, _values, _timestamp, _index=None):
+		self.keys = _keys
+		self.values = _values
+		self.timestamp = _timestamp
+		if _index is None:
+			_index = {key: i for i, key in enumerate(_keys)}
+		self._index = _index
+
+	def get(self, key, default=None):
+		i = self._index.get(key)
+		if i is None:
+			return default
+		return self.values[i]
+
+	def __getitem__(self, key):
+		return self.values[self._index[key]]
+
+	def __contains__(self, key):
+		return key in self._index
+
+	def json(self):
+		return dict(zip(self.keys, self.values))
+
+
+class DefinitionGroup(object):
+	"""Many simvars packed into one data definition and read with one request.
+
+	_fields is a list of (key, datum name, units) or (key, datum name, units,
+	datatype) tuples. Without an explicit datatype numeric datums are read as
+	FLOAT64 and string datums (units containing 'string' or None) as
+	STRING256, so the response always has a fixed layout. Each response is
+	decoded into a new immutable Snapshot that replaces outData in one
+	assignment.
+
+	_epsilon maps keys to deadbands that override the DEFAULT_EPSILON table;
+	they only take effect for subscriptions with changed=True.
+
+	disable() rebuilds the definition from the dispatch thread, so it and
+	every (re)definition run under the group's lock.
+	"""
+
+	def get(self):
+		return self.value
+
+	def latest(self):
+		# Pushed snapshot while subscribed, otherwise a one-shot read.
+		if self.subscribed:
+			return self.outData
+		return self.value
+
+	@property
+	def value(self):
+		if self._deff_test():
+			if (self.LastData + self.time) < millis():
+				if self.sm.get_data(self):
+					self.LastData = millis()
+				else:
+					return None
+			return self.outData
+		else:
+			return None
+
+	def __init__(self, _fields, _sm, _time=10, _attemps=10, _epsilon=None):
+		self._lock = threading.RLock()
+		self.DATA_DEFINITION_ID = None
+		self.DATA_REQUEST_ID = None
+		self.keys = []
+		self.definitions = []
+		self.outData = None
+		self.attemps = _attemps
+		self.sm = _sm
+		self.time = _time
+		self.defined = False
+		self.LastData = 0
+		self.LastID = 0
+		self.subscribed = False
+		self.period = SIMCONNECT_PERIOD.SIMCONNECT_PERIOD_NEVER
+		self.flags = SIMCONNECT_DATA_REQUEST_FLAG.SIMCONNECT_DATA_REQUEST_FLAG_DEFAULT
+		self.exceptions = {}
+		self.disabled = []
+		for field in _fields:
+			(key, datum, units) = field[:3]
+			if len(field) > 3:
+				datatype = field[3]
+			else:
+				datatype = self._default_type(units)
+			epsilon = epsilon_for(key, _epsilon)
+			if is_string_type(datatype):
+				units = None
+				epsilon = 0
+			self.keys.append(key)
+			self.definitions.append((datum, units, datatype, epsilon))
+		self._build_layout()
+
+	def _build_layout(self):
+		self._layout = DataLayout([deff[2] for deff in self.definitions])
+		# Shared by every snapshot of this layout; disable() builds new ones.
+		self._keys = tuple(self.keys)
+		self._index = {key: i for i, key in enumerate(self._keys)}
+
+	def _datum_id(self, i):
+		return SIMCONNECT_UNUSED
+
+	def _default_type(self, units):
+		if units is None or 'string' in units.decode().lower():
+			return SIMCONNECT_DATATYPE.SIMCONNECT_DATATYPE_STRING256
+		return SIMCONNECT_DATATYPE.SIMCONNECT_DATATYPE_FLOAT64
+
+	def decode(self, ObjData):
+		snapshot = Snapshot(self._keys, self._layout.decode(ObjData), millis(), self._index)
+		self.outData = snapshot
+		self.LastData = snapshot.timestamp
+		if self.subscribed:
+			self.sm.store.publish(snapshot, self)
+
+	def subscribe(self, period=SIMCONNECT_PERIOD.SIMCONNECT_PERIOD_SIM_FRAME, changed=False):
+		# Have the sim push the group every period; with changed=True it only
+		# sends when at least one datum differs from the previous push.
+		if not self._deff_test():
+			return False
+		flags = SIMCONNECT_DATA_REQUEST_FLAG.SIMCONNECT_DATA_REQUEST_FLAG_DEFAULT
+		if changed:
+			flags = SIMCONNECT_DATA_REQUEST_FLAG.SIMCONNECT_DATA_REQUEST_FLAG_CHANGED
+		err = self.sm.dll.RequestDataOnSimObject(
+			self.sm.hSimConnect,
+			self.DATA_REQUEST_ID.value,
+			self.DATA_DEFINITION_ID.value,
+			SIMCONNECT_OBJECT_ID_USER,
+			period,
+			flags,
+			0,
+			0,
+			0,
+		)
+		self.sm.track(self)
+		if not self.sm.IsHR(err, 0):
+			return False
+		self.period = period
+		self.flags = flags
+		self.subscribed = period != SIMCONNECT_PERIOD.SIMCONNECT_PERIOD_NEVER
+		return True
+
+	def unsubscribe(self):
+		return self.subscribe(SIMCONNECT_PERIOD.SIMCONNECT_PERIOD_NEVER)
+
+	def write(self, values):
+		# Set every field of the group on the user aircraft with one
+		# SetDataOnSimObject; values maps each key to its new value.
+		with self._lock:
+			if not self._deff_test():
+				return False
+			data = create_string_buffer(self._layout.size)
+			self._layout.pack_into(data, [values[key] for key in self.keys])
+			err = self.sm.dll.SetDataOnSimObject(
+				self.sm.hSimConnect,
+				self.DATA_DEFINITION_ID.value,
+				SIMCONNECT_OBJECT_ID_USER,
+				SIMCONNECT_DATA_SET_FLAG.SIMCONNECT_DATA_SET_FLAG_DEFAULT,
+				0,
+				self._layout.size,
+				cast(data, c_void_p),
+			)
+			self.sm.track(self)
+			return self.sm.IsHR(err, 0)
+
+	def replay(self):
+		# Define again on a new connection and restore the subscription.
+		if self.subscribed:
+			changed = self.flags == SIMCONNECT_DATA_REQUEST_FLAG.SIMCONNECT_DATA_REQUEST_FLAG_CHANGED
+			return self.subscribe(self.period, changed)
+		return self._deff_test()
+
+	def on_exception(self, exception, datum):
+		# Called from the dispatch thread. datum is the key whose
+		# AddToDataDefinition failed, or None for request-level packets.
+		# A rejected datum is only reported once, when it is added, so it
+		# is dropped right away rather than after exception_limit.
+		self.exceptions[datum] = self.exceptions.get(datum, 0) + 1
+		LOGGER.warning("%s: in %s" % (exception.name, datum))
+		if datum not in self.keys:
+			return
+		if exception in DATUM_REJECTED or self.exceptions[datum] >= self.sm.exception_limit:
+			self.disable(datum)
+
+	def disable(self, key):
+		# Drop a failing datum and rebuild the definition without it, so it
+		# stops costing an exception round-trip on every request.
+		with self._lock:
+			if key not in self.keys:
+				return
+			LOGGER.error("Disabled after %d exceptions: %s" % (self.exceptions.get(key, 0), key))
+			i = self.keys.index(key)
+			del self.keys[i]
+			del self.definitions[i]
+			self.disabled.append(key)
+			self._build_layout()
+			self.outData = None
+			if self.DATA_DEFINITION_ID is not None:
+				self.sm.dll.ClearDataDefinition(
+					self.sm.hSimConnect,
+					self.DATA_DEFINITION_ID.value,
+				)
+			self.defined = False
+			self.replay()
+
+	def release(self):
+		# Clear the definition and hand both IDs back for reuse.
+		with self._lock:
+			if self.DATA_DEFINITION_ID is None:
+				return
+			if self.subscribed:
+				self.unsubscribe()
+			self.sm.release_def_id(self.DATA_DEFINITION_ID)
+			self.sm.release_request_id(self.DATA_REQUEST_ID)
+			self.DATA_DEFINITION_ID = None
+			self.DATA_REQUEST_ID = None
+			self.defined = False
+
+	def _deff_test(self):
+		if self.defined is True:
+			return True
+		with self._lock:
+			if self.defined is True:
+				return True
+			return self._define()
+
+	def _define(self):
+		if not self.definitions:
+			return False
+		if self.DATA_DEFINITION_ID is None:
+			self.DATA_DEFINITION_ID = self.sm.new_def_id()
+			self.DATA_REQUEST_ID = self.sm.new_request_id()
+			self.outData = None
+			self.sm.Requests[self.DATA_REQUEST_ID.value] = self
+
+		for i, (key, (datum, units, DATATYPE, epsilon)) in enumerate(zip(self.keys, self.definitions)):
+			err = self.sm.dll.AddToDataDefinition(
+				self.sm.hSimConnect,
+				self.DATA_DEFINITION_ID.value,
+				datum,
+				units,
+				DATATYPE,
+				epsilon,
+				self._datum_id(i),
+			)
+			self.LastID = self.sm.track(self, key)
+			if not self.sm.IsHR(err, 0):
+				LOGGER.error("SIM def" + str((datum, units)))
+				self.sm.dll.ClearDataDefinition(
+					self.sm.hSimConnect,
+					self.DATA_DEFINITION_ID.value,
+				)
+				return False
+
+		self.defined = True
+		return True
+
+
+class WritableGroup(DefinitionGroup):
+	"""A DefinitionGroup of settable simvars written in one call.
+
+	Values are staged with set() and sent by commit(). A bit per field
+	marks what is staged: when every field is, commit() sends the packed
+	struct; otherwise only the staged fields go out as
+	SIMCONNECT_DATA_SET_FLAG_TAGGED (datum ID, value) pairs, so fields
+	nobody touched keep their sim value. Datum IDs are field positions.
+
+	The sim reports a rejected write later, as an exception against the
+	packet rather than a field; on_reject(exception, commit) is then
+	called from the dispatch thread with the _Commit that was sent.
+	"""
+
+	def __init__(self, _fields, _sm, _time=10, _attemps=10, _epsilon=None):
+		self.staged = []
+		self.dirty = 0
+		self.on_reject = None
+		DefinitionGroup.__init__(self, _fields, _sm, _time=_time, _attemps=_attemps, _epsilon=_epsilon)
+
+	def _build_layout(self):
+		DefinitionGroup._build_layout(self)
+		self._tags = [struct.Struct('<I' + DATATYPE_FORMATS[deff[2]]) for deff in self.definitions]
+		self._full = (1 << len(self.keys)) - 1
+		self.staged = [None] * len(self.keys)
+		self.dirty = 0
+
+	def _datum_id(self, i):
+		return i
+
+	def mask(self, keys):
+		# Bit mask of the given keys; unknown ones are ignored.
+		bits = 0
+		for key in keys:
+			i = self._index.get(key)
+			if i is not None:
+				bits |= 1 << i
+		return bits
+
+	def set(self, key, value):
+		with self._lock:
+			i = self._index.get(key)
+			if i is None:
+				return False
+			self.staged[i] = value
+			self.dirty |= 1 << i
+			return True
+
+	def write(self, values):
+		# Stage values ({key: value}, any subset of the keys) and commit.
+		for key, value in values.items():
+			self.set(key, value)
+		return self.commit()
+
+	def commit(self, mask=None, tag=None):
+		# Send the staged fields (only those in mask, if given) and clear
+		# them, sent or not; returns False if nothing was staged or the
+		# call failed. tag is handed back to on_reject with the commit.
+		with self._lock:
+			bits = self.dirty if mask is None else self.dirty & mask
+			if bits == 0:
+				return False
+			self.dirty &= ~bits
+			if not self._deff_test():
+				return False
+			fields = [i for i in range(len(self.keys)) if bits & (1 << i)]
+			if bits == self._full:
+				flags = SIMCONNECT_DATA_SET_FLAG.SIMCONNECT_DATA_SET_FLAG_DEFAULT
+				data = create_string_buffer(self._layout.size)
+				self._layout.pack_into(data, self.staged)
+				size = self._layout.size
+			else:
+				flags = SIMCONNECT_DATA_SET_FLAG.SIMCONNECT_DATA_SET_FLAG_TAGGED
+				size = sum(self._tags[i].size for i in fields)
+				data = create_string_buffer(size)
+				offset = 0
+				for i in fields:
+					self._tags[i].pack_into(data, offset, i, self.staged[i])
+					offset += self._tags[i].size
+			err = self.sm.dll.SetDataOnSimObject(
+				self.sm.hSimConnect,
+				self.DATA_DEFINITION_ID.value,
+				SIMCONNECT_OBJECT_ID_USER,
+				flags,
+				0,
+				size,
+				cast(data, c_void_p),
+			)
+			self.sm.track(self, _Commit({self.keys[i]: self.staged[i] for i in fields}, tag))
+			return self.sm.IsHR(err, 0)
+
+	def on_exception(self, exception, datum):
+		# Write exceptions carry the _Commit tracked above; anything else
+		# is about the definition itself.
+		if not isinstance(datum, _Commit):
+			return DefinitionGroup.on_exception(self, exception, datum)
+		LOGGER.warning("%s: writing %s" % (exception.name, ", ".join(datum.values)))
+		if self.on_reject is not None:
+			self.on_reject(exception, datum)
+
+
+class _Commit(object):
+	# One SetDataOnSimObject packet: the {key: value} it carried and the
+	# caller's tag, recorded against its send ID.
+	__slots__ = ("values", "tag")
+
+	def __init__(self, values, tag):
+		self.values = values
+		self.tag = tag
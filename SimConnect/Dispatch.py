@@ -0,0 +1,205 @@
+import struct
+import threading
+from .Enum import *
+from .Constants import *
+
+
+# ----------------------------------------------------------------------------
+#        Wait strategies
+#
+# A wait strategy decides how the dispatch thread sleeps once the message
+# queue is empty. `handle` is passed to SimConnect_Open as hEventHandle so
+# the backend can wake the dispatcher as soon as a message is queued.
+# SimConnect calls open() before every SimConnect_Open and close() from
+# exit(), so a handle lives exactly as long as one connection.
+# ----------------------------------------------------------------------------
+
+
+class WaitStrategy(object):
+	handle = None
+
+	def open(self):
+		pass
+
+	def wait(self, drained):
+		# Called after every drain with the number of messages processed.
+		pass
+
+	def signal(self):
+		# Wake a waiting dispatcher, e.g. on exit.
+		pass
+
+	def close(self):
+		pass
+
+
+class BackoffWait(WaitStrategy):
+	"""Adaptive sleep: short while messages flow, doubling up to max_sleep when idle.
+
+	signal() cuts the current sleep short, so a backend that calls it when
+	it queues a message gets event-driven wakeups with this as the fallback.
+	"""
+
+	def __init__(self, min_sleep=.0005, max_sleep=.05):
+		self.min_sleep = min_sleep
+		self.max_sleep = max_sleep
+		self.delay = min_sleep
+		self._wake = threading.Event()
+
+	def next_delay(self, drained):
+		if drained:
+			self.delay = self.min_sleep
+		else:
+			self.delay = min(self.delay * 2, self.max_sleep)
+		return self.delay
+
+	def wait(self, drained):
+		self._wake.wait(self.next_delay(drained))
+		self._wake.clear()
+
+	def signal(self):
+		self._wake.set()
+
+
+class ThreadEventWait(BackoffWait):
+	"""Event-signalled wait for in-process backends.
+
+	The backend receives this object as its event handle and calls signal()
+	whenever it queues a message; the backoff only bounds a missed signal.
+	"""
+
+	def __init__(self, min_sleep=.01, max_sleep=.25):
+		super().__init__(min_sleep, max_sleep)
+		self.handle = self
+
+
+class Win32EventWait(BackoffWait):
+	"""Auto-reset Win32 event that SimConnect sets whenever a message is queued."""
+
+	def __init__(self, min_sleep=.01, max_sleep=.25):
+		super().__init__(min_sleep, max_sleep)
+		self.kernel32 = windll.kernel32
+		self.kernel32.CreateEventW.restype = HANDLE
+		self.kernel32.CreateEventW.argtypes = [c_void_p, BOOL, BOOL, LPCWSTR]
+		self.kernel32.WaitForSingleObject.restype = DWORD
+		self.kernel32.WaitForSingleObject.argtypes = [HANDLE, DWORD]
+		self.kernel32.SetEvent.argtypes = [HANDLE]
+		self.kernel32.CloseHandle.argtypes = [HANDLE]
+		self.handle = None
+		self.open()
+
+	def open(self):
+		if self.handle:
+			return
+		self.handle = self.kernel32.CreateEventW(None, False, False, None)
+		if not self.handle:
+			raise OSError("CreateEventW failed")
+
+	def wait(self, drained):
+		if not self.handle:
+			# Closed by exit() from the dispatch thread itself.
+			return BackoffWait.wait(self, drained)
+		self.kernel32.WaitForSingleObject(self.handle, int(self.next_delay(drained) * 1000))
+
+	def signal(self):
+		if self.handle:
+			self.kernel32.SetEvent(self.handle)
+
+	def close(self):
+		if self.handle:
+			self.kernel32.CloseHandle(self.handle)
+			self.handle = None
+
+
+def default_wait_strategy():
+	try:
+		return Win32EventWait()
+	except (NameError, AttributeError, OSError):
+		return BackoffWait()
+
+
+# ----------------------------------------------------------------------------
+#        Dispatch engine
+# ----------------------------------------------------------------------------
+
+
+_RECV_ID = struct.Struct('<I' if sizeof(DWORD) == 4 else '<Q')
+_RECV_ID_OFFSET = SIMCONNECT_RECV.dwID.offset
+
+# Data messages decoded straight out of the batch buffer.
+_DATA_MESSAGES = {
+	SIMCONNECT_RECV_ID.SIMCONNECT_RECV_ID_SIMOBJECT_DATA.value: SIMCONNECT_RECV_SIMOBJECT_DATA,
+	SIMCONNECT_RECV_ID.SIMCONNECT_RECV_ID_SIMOBJECT_DATA_BYTYPE.value: SIMCONNECT_RECV_SIMOBJECT_DATA_BYTYPE,
+	SIMCONNECT_RECV_ID.SIMCONNECT_RECV_ID_CLIENT_DATA.value: SIMCONNECT_RECV_CLIENT_DATA,
+}
+
+
+class DispatchEngine(object):
+	"""Drains every queued message per wakeup, then sleeps via the wait strategy.
+
+	With a ring (see Ring.py) the queue is first copied into one batch
+	buffer and the batch is walked in a single pass; data messages go to
+	handle_simobject_event directly, everything else through
+	my_dispatch_proc as before.
+	"""
+
+	def __init__(self, _sm, _wait=None, _ring=None):
+		self.sm = _sm
+		if _wait is None:
+			_wait = default_wait_strategy()
+		self.wait = _wait
+		self.ring = _ring
+		self.messages = 0
+		self.wakeups = 0
+
+	def drain(self):
+		if self.ring is not None:
+			return self._drain_ring()
+		count = 0
+		pData = POINTER(SIMCONNECT_RECV)()
+		cbData = DWORD(0)
+		while self.sm.quit == 0:
+			try:
+				hr = self.sm.dll.GetNextDispatch(self.sm.hSimConnect, byref(pData), byref(cbData))
+			except OSError:
+				# The DLL's HRESULT restype raises E_FAIL once the queue is empty.
+				break
+			if not self.sm.IsHR(hr, 0) or not pData:
+				break
+			self.sm.my_dispatch_proc(pData, cbData.value, None)
+			count += 1
+		self.messages += count
+		return count
+
+	def _drain_ring(self):
+		ring = self.ring
+		sm = self.sm
+		count = ring.drain(sm)
+		buffer = ring.buffer
+		address = ring.address
+		offsets = ring.offsets
+		sizes = ring.sizes
+		for i in range(count):
+			if sm.quit != 0:
+				break
+			offset = offsets[i]
+			cls = _DATA_MESSAGES.get(_RECV_ID.unpack_from(buffer, offset + _RECV_ID_OFFSET)[0])
+			if cls is not None:
+				sm.handle_simobject_event(cls.from_buffer(buffer, offset))
+			else:
+				sm.my_dispatch_proc(cast(address + offset, POINTER(SIMCONNECT_RECV)), sizes[i], None)
+		self.messages += count
+		return count
+
+	def run(self):
+		while self.sm.quit == 0:
+			drained = 0
+			try:
+				drained = self.drain()
+			except OSError as err:
+				LOGGER.error("OS error: {0}".format(err))
+			self.wakeups += 1
+			self.wait.wait(drained)
+
+	def stop(self):
+		self.wait.signal()
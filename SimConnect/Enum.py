@@ -350,9 +350,7 @@ class SIMCONNECT_RECV_EXCEPTION(
 ):  # when dwID == SIMCONNECT_RECV_ID_EXCEPTION
 	_fields_ = [
 		("dwException", DWORD),  # see SIMCONNECT_EXCEPTION
-		("UNKNOWN_SENDID", DWORD),  #
 		("dwSendID", DWORD),  # see SimConnect_GetLastSentPacketID
-		("UNKNOWN_INDEX", DWORD),  #
 		("dwIndex", DWORD),  # index of parameter that was source of error
 	]
 
@@ -1,4 +1,17 @@
 from SimConnect import *
+from .Constants import *
+
+
+# Mapped in one batch by warm() right after connect, so the first command
+# does not pay for MapClientEventToSimEvent.
+WARM_EVENTS = [
+	"XPNDR_SET",
+	"ADF_COMPLETE_SET",
+	"GEAR_SET",
+	"FLAPS_SET",
+	"AUTOPILOT_ON",
+	"AUTOPILOT_OFF",
+]
 
 
 class Event(object):
@@ -16,16 +29,19 @@ class Event(object):
 
 
 class EventHelper:
+	# name -> list entry, filled per helper class by _build_index().
+	_index = {}
+
 	def __init__(self, _sm):
 		self.sm = _sm
 
 	def __getattr__(self, _name):
-		for key in self.list:
-			if _name == key[0].decode():
-				ne = Event(key[0], self.sm, _dec=key[1])
-				setattr(self, _name, ne)
-				return ne
-		return None
+		key = type(self)._index.get(_name)
+		if key is None:
+			return None
+		ne = Event(key[0], self.sm, _dec=key[1])
+		setattr(self, _name, ne)
+		return ne
 
 	def get(self, _name):
 		return getattr(self, _name)
@@ -35,8 +51,11 @@ class EventHelper:
 
 
 class AircraftEvents():
-	def __init__(self, _sm):
+	_slots = None
+
+	def __init__(self, _sm, _warm=None):
 		self.sm = _sm
+		self.warm_set = list(WARM_EVENTS if _warm is None else _warm)
 		self.list = []
 		self.Engine = self.__Engine(_sm)
 		self.list.append(self.Engine)
@@ -82,13 +101,37 @@ class AircraftEvents():
 		self.list.append(self.ATC)
 		self.Multiplayer = self.__Multiplayer(_sm)
 		self.list.append(self.Multiplayer)
+		if AircraftEvents._slots is None:
+			# name -> position in self.list, shared by every instance; merged
+			# back to front so the first helper wins on duplicates.
+			slots = {}
+			for (i, clas) in reversed(list(enumerate(self.list))):
+				slots.update(dict.fromkeys(type(clas)._index, i))
+			AircraftEvents._slots = slots
 
 	def find(self, key):
-		for clas in self.list:
-			for test in clas.list:
-				if key == test[0].decode():
-					return getattr(clas, key)
-		return None
+		i = self._slots.get(key)
+		if i is None:
+			return None
+		return getattr(self.list[i], key)
+
+	def warm(self, names=None):
+		# Map the warm set (plus names) now; only meaningful while connected.
+		if names:
+			self.warm_set.extend(n for n in names if n not in self.warm_set)
+		if not self.sm.ok:
+			return 0
+		count = 0
+		for name in self.warm_set:
+			event = self.find(name)
+			if event is None:
+				LOGGER.warning("Unknown warm event: %s" % (name))
+				continue
+			if event.event is None:
+				event.event = self.sm.map_to_sim_event(event.deff)
+			if event.event is not None:
+				count += 1
+		return count
 
 	class __Engine(EventHelper):
 		list = [
@@ -1225,3 +1268,16 @@ class AircraftEvents():
 			(b'G1000_MFD_PAGE_KNOB_DEC', "Step down through the individual pages.", "Shared Cockpit"),
 		]
 		# G1000_MFD_SOFTKEY1, G1000_MFD_SOFTKEY12	Initiate the action for the icon displayed in the softkey position.	Shared Cockpit
+
+
+def _build_index():
+	# name -> list entry per helper class, built once at import.
+	for clas in vars(AircraftEvents).values():
+		if isinstance(clas, type) and issubclass(clas, EventHelper):
+			index = {}
+			for key in reversed(clas.list):
+				index[key[0].decode()] = key
+			clas._index = index
+
+
+_build_index()
@@ -0,0 +1,81 @@
+from .Enum import *
+from .Constants import *
+
+
+class EventListener(object):
+	"""Callbacks for key events, whoever triggers them.
+
+	Every event passed to on() is mapped and added, non-maskable, to this
+	listener's notification group. The sim then reports it as
+	SIMCONNECT_RECV_ID_EVENT whether it came from a cockpit switch, another
+	add-on or this client, and still acts on it. Callbacks run on the
+	dispatch thread as callback(name, data) and must not block.
+
+	Events registered while disconnected are added by attach(), which the
+	broker calls after every connect; the session replays the rest.
+	"""
+
+	def __init__(self, _sm, priority=SIMCONNECT_GROUP_PRIORITY_HIGHEST):
+		self.sm = _sm
+		self.priority = priority
+		self.group = _sm.group_ids.acquire("Listener")
+		# event ID -> name, event ID -> [callback]
+		self.names = {}
+		self.callbacks = {}
+		self.pending = []
+		self.prioritised = False
+		_sm.listeners[self.group.value] = self
+
+	def on(self, name, callback):
+		# name is a key event such as "XPNDR_SET".
+		self.pending.append((name, callback))
+		return self.attach()
+
+	def off(self, name, callback=None):
+		# Drop callback (all of them if None); the event stays in the group.
+		self.pending = [(n, c) for (n, c) in self.pending if n != name or (callback is not None and c != callback)]
+		for evnt, evnt_name in self.names.items():
+			if evnt_name == name:
+				callbacks = self.callbacks[evnt]
+				callbacks[:] = [c for c in callbacks if callback is not None and c != callback]
+
+	def attach(self):
+		# Map and add what was registered while disconnected.
+		if not self.sm.ok:
+			return False
+		(pending, self.pending) = (self.pending, [])
+		for (name, callback) in pending:
+			evnt = self.sm.map_to_sim_event(name.encode())
+			if evnt is None:
+				LOGGER.error("Cannot listen to %s" % (name))
+				continue
+			if evnt.value not in self.callbacks:
+				self.sm.add_to_notification_group(self.group, evnt, False)
+				self.names[evnt.value] = name
+				self.callbacks[evnt.value] = []
+			self.callbacks[evnt.value].append(callback)
+		if self.callbacks and not self.prioritised:
+			self.sm.set_notification_group_priority(self.group, self.priority)
+			self.prioritised = True
+		return True
+
+	def dispatch(self, event):
+		# Called from the dispatch thread with a SIMCONNECT_RECV_EVENT.
+		name = self.names.get(event.uEventID)
+		for callback in list(self.callbacks.get(event.uEventID, ())):
+			try:
+				callback(name, event.dwData)
+			except Exception:
+				LOGGER.exception("Event callback failed: %s" % (name))
+
+	def release(self):
+		self.sm.listeners.pop(self.group.value, None)
+		if self.sm.ok:
+			self.sm.dll.ClearNotificationGroup(self.sm.hSimConnect, self.group)
+		self.sm.session.notifications = [
+			entry for entry in self.sm.session.notifications if entry[0] != self.group.value
+		]
+		self.sm.session.priorities.pop(self.group.value, None)
+		self.sm.group_ids.release(self.group)
+		self.names = {}
+		self.callbacks = {}
@@ -1,6 +1,7 @@
 from SimConnect import *
 from .Enum import *
 from .Constants import *
+from .FacilityStore import FacilityStore
 
 
 class Facilitie(object):
@@ -14,9 +15,16 @@ class FacilitiesHelper:
 		self.parent = _parent
 		self.REQUEST_ID = _sm.new_request_id()
 		self.item = None
+		self.cb = None
 		self.sm.Facilities.append(self)
 
+	@property
+	def table(self):
+		return self.parent.store.table(self.item)
+
 	def subscribe(self, _cbfunc):
+		# _cbfunc(table) runs on the dispatch thread after every list that
+		# comes into range has been merged into the store.
 		if self.item < SIMCONNECT_FACILITY_LIST_TYPE.SIMCONNECT_FACILITY_LIST_TYPE_COUNT:
 			self.cb = _cbfunc
 			hr = self.sm.dll.SubscribeToFacilities(
@@ -35,17 +43,33 @@ class FacilitiesHelper:
 	def get(self):
 		# Get the current cached list of airports, waypoints, etc, as the item indicates
 		if self.item < SIMCONNECT_FACILITY_LIST_TYPE.SIMCONNECT_FACILITY_LIST_TYPE_COUNT:
+			self.parent.store.updated[self.item].clear()
 			hr = self.sm.dll.RequestFacilitiesList(
 				self.sm.hSimConnect,
 				SIMCONNECT_FACILITY_LIST_TYPE(self.item),
 				self.REQUEST_ID.value
 			)
-			# self.sm.run()
+
+	def wait(self, timeout=None):
+		# Block until the store holds a complete list of this type.
+		return self.parent.store.updated[self.item].wait(timeout)
+
+	def find(self, icao):
+		return self.table.get(icao)
+
+	def dump(self, pFac):
+		# One page of a facility list, called from the dispatch thread.
+		List = cast(pFac, POINTER(SIMCONNECT_RECV_FACILITIES_LIST)).contents
+		table = self.parent.store.add_page(self.item, List, replace=self.cb is None)
+		if table is not None and self.cb is not None:
+			self.cb(table)
 
 
 class FacilitiesRequests():
-	def __init__(self, _sm):
+	def __init__(self, _sm, _path=None):
+		# _path: facility cache file, loaded now if it exists; see save().
 		self.sm = _sm
+		self.store = FacilityStore(_path)
 		self.list = []
 		self.Airports = self.__FACILITY_AIRPORT(_sm, self)
 		self.list.append(self.Airports)
@@ -57,56 +81,33 @@ class FacilitiesRequests():
 		self.list.append(self.VORs)
 
 	def dump(self, pList):
-		pList = cast(pList, POINTER(SIMCONNECT_RECV_FACILITIES_LIST))
-		List = pList.contents
-		print("RequestID: %d  dwArraySize: %d  dwEntryNumber: %d  dwOutOf: %d" % (
+		List = cast(pList, POINTER(SIMCONNECT_RECV_FACILITIES_LIST)).contents
+		LOGGER.debug("RequestID: %d  dwArraySize: %d  dwEntryNumber: %d  dwOutOf: %d" % (
 			List.dwRequestID, List.dwArraySize, List.dwEntryNumber, List.dwOutOf)
 		)
 
-	# Dump various facility elements
+	def find(self, icao):
+		return self.store.find(icao)
+
+	def save(self, path=None):
+		self.store.save(path)
+
 	class __FACILITY_AIRPORT(FacilitiesHelper):
 		def __init__(self, _sm, _parent):
 			super().__init__(_sm, _parent)
 			self.item = SIMCONNECT_FACILITY_LIST_TYPE.SIMCONNECT_FACILITY_LIST_TYPE_AIRPORT
 
-		def dump(self, pFac):
-			pFac = cast(pFac, POINTER(SIMCONNECT_DATA_FACILITY_AIRPORT))
-			Fac = pFac.contents
-			print("Icao: %s  Latitude: %lg  Longitude: %lg  Altitude: %lg" % (
-				Fac.Icao.decode(), Fac.Latitude, Fac.Longitude, Fac.Altitude)
-			)
-
 	class __FACILITY_WAYPOINT(FacilitiesHelper):
 		def __init__(self, _sm, _parent):
 			super().__init__(_sm, _parent)
 			self.item = SIMCONNECT_FACILITY_LIST_TYPE.SIMCONNECT_FACILITY_LIST_TYPE_WAYPOINT
 
-		def dump(self, pFac):
-			pFac = cast(pFac, POINTER(SIMCONNECT_DATA_FACILITY_WAYPOINT))
-			Fac = pFac.contents
-			self.parent.Airports.dump(pFac)
-			print("\tfMagVar: %g" % (Fac.fMagVar))
-
 	class __FACILITY_NDB(FacilitiesHelper):
 		def __init__(self, _sm, _parent):
 			super().__init__(_sm, _parent)
 			self.item = SIMCONNECT_FACILITY_LIST_TYPE.SIMCONNECT_FACILITY_LIST_TYPE_NDB
 
-		def dump(self, pFac):
-			pFac = cast(pFac, POINTER(SIMCONNECT_DATA_FACILITY_NDB))
-			Fac = pFac.contents
-			self.parent.Waypoints.dump(pFac)
-			print("\t\tfFrequency: %d" % (Fac.fFrequency))
-
 	class __FACILITY_VOR(FacilitiesHelper):
 		def __init__(self, _sm, _parent):
 			super().__init__(_sm, _parent)
 			self.item = SIMCONNECT_FACILITY_LIST_TYPE.SIMCONNECT_FACILITY_LIST_TYPE_VOR
-
-		def dump(self, pFac):
-			pFac = cast(pFac, POINTER(SIMCONNECT_DATA_FACILITY_VOR))
-			Fac = pFac.contents
-			self.parent.NDBs.dump(pFac)
-			print("\t\t\tFlags: %x  fLocalizer: %f  GlideLat: %lg  GlideLon: %lg  GlideAlt: %lg  fGlideSlopeAngle: %f" % (
-				Fac.Flags, Fac.fLocalizer, Fac.GlideLat, Fac.GlideLon, Fac.GlideAlt, Fac.fGlideSlopeAngle)
-			)
@@ -0,0 +1,317 @@
+import mmap
+import os
+import struct
+import threading
+from array import array
+from ctypes import addressof, sizeof, string_at
+from .Enum import *
+from .Constants import *
+
+
+# ----------------------------------------------------------------------------
+#        Facility store
+#
+# Facility lists arrive as SIMCONNECT_RECV_FACILITIES_LIST pages of packed
+# records (SimConnect.h is #pragma pack(1)), dwEntryNumber of dwOutOf. The
+# store collects the pages of one list, parses them with struct and keeps
+# every facility type as a table of columns plus an ICAO -> row index.
+#
+# save() writes all tables to one file laid out for mmap:
+#
+#   header   magic, version, table count
+#   per table  type, rows, then each column as one 8-byte aligned block
+#
+# load() maps the file and hands out memoryviews over those blocks, so a
+# warm start costs one mmap and an index build, not a round of requests.
+# ----------------------------------------------------------------------------
+
+AIRPORT = SIMCONNECT_FACILITY_LIST_TYPE.SIMCONNECT_FACILITY_LIST_TYPE_AIRPORT
+WAYPOINT = SIMCONNECT_FACILITY_LIST_TYPE.SIMCONNECT_FACILITY_LIST_TYPE_WAYPOINT
+NDB = SIMCONNECT_FACILITY_LIST_TYPE.SIMCONNECT_FACILITY_LIST_TYPE_NDB
+VOR = SIMCONNECT_FACILITY_LIST_TYPE.SIMCONNECT_FACILITY_LIST_TYPE_VOR
+
+ICAO_SIZE = 9
+
+# Columns after icao, in wire order: (name, struct code).
+_AIRPORT = [("lat", "d"), ("lon", "d"), ("alt", "d")]
+_WAYPOINT = _AIRPORT + [("magvar", "f")]
+_NDB = _WAYPOINT + [("frequency", "I")]
+_VOR = _NDB + [
+	("flags", "I"),
+	("localizer", "f"),
+	("glide_lat", "d"),
+	("glide_lon", "d"),
+	("glide_alt", "d"),
+	("glide_angle", "f"),
+]
+
+COLUMNS = {AIRPORT: _AIRPORT, WAYPOINT: _WAYPOINT, NDB: _NDB, VOR: _VOR}
+
+RECORDS = {
+	kind: struct.Struct("<%ds" % (ICAO_SIZE) + "".join(code for name, code in columns))
+	for kind, columns in COLUMNS.items()
+}
+
+# Records start right after the list header.
+LIST_HEADER = sizeof(SIMCONNECT_RECV_FACILITIES_LIST)
+
+_FILE_MAGIC = b"OSFC"
+_FILE_VERSION = 1
+_FILE_HEADER = struct.Struct("<4sII")
+_TABLE_HEADER = struct.Struct("<II")
+
+
+def _align(n):
+	return (n + 7) & ~7
+
+
+class FacilityTable(object):
+	"""Every facility of one list type, stored column by column.
+
+	icao holds the ICAO codes back to back, ICAO_SIZE bytes each; every
+	other column is a typed array (or a memoryview over a mapped file).
+	"""
+
+	def __init__(self, kind, rows=0):
+		self.kind = SIMCONNECT_FACILITY_LIST_TYPE(kind)
+		self.columns = COLUMNS[self.kind]
+		self.rows = rows
+		self.icao = bytearray(rows * ICAO_SIZE)
+		for (name, code) in self.columns:
+			setattr(self, name, array(code, [0]) * rows)
+		# Rows of the previous table that merge() overwrote in place.
+		self.replaced = ()
+		self._index = None
+
+	def __len__(self):
+		return self.rows
+
+	@classmethod
+	def from_records(cls, kind, data):
+		# Build the columns from packed wire records: unpack every record,
+		# then transpose into one array per column.
+		kind = SIMCONNECT_FACILITY_LIST_TYPE(kind)
+		record = RECORDS[kind]
+		rows = len(data) // record.size
+		table = cls(kind)
+		table.rows = rows
+		if rows == 0:
+			return table
+		columns = list(zip(*record.iter_unpack(data[:rows * record.size])))
+		table.icao = bytearray(b"".join(columns[0]))
+		for ((name, code), values) in zip(table.columns, columns[1:]):
+			setattr(table, name, array(code, values))
+		return table
+
+	def key(self, i):
+		raw = bytes(self.icao[i * ICAO_SIZE:(i + 1) * ICAO_SIZE])
+		return raw.split(b"\0", 1)[0].decode("ascii", "replace").strip()
+
+	@property
+	def index(self):
+		# ICAO -> row; built on first use. The first row wins on duplicates.
+		if self._index is None:
+			raw = bytes(self.icao)
+			keys = [
+				raw[i:i + ICAO_SIZE].split(b"\0", 1)[0].decode("ascii", "replace").strip()
+				for i in range(0, self.rows * ICAO_SIZE, ICAO_SIZE)
+			]
+			# Built back to front so the first row wins on duplicates.
+			self._index = dict(zip(reversed(keys), range(self.rows - 1, -1, -1)))
+		return self._index
+
+	def find(self, icao):
+		return self.index.get(icao.upper())
+
+	def row(self, i):
+		out = {"icao": self.key(i)}
+		for (name, code) in self.columns:
+			out[name] = getattr(self, name)[i]
+		return out
+
+	def get(self, icao, default=None):
+		i = self.find(icao)
+		if i is None:
+			return default
+		return self.row(i)
+
+	def merge(self, other):
+		# New table with other's rows replacing ours of the same ICAO and
+		# the rest appended, e.g. for facilities coming into range.
+		index = self.index
+		fresh = [i for i in range(other.rows) if other.key(i) not in index]
+		merged = FacilityTable(self.kind, self.rows + len(fresh))
+		merged.icao[:self.rows * ICAO_SIZE] = self.icao
+		for (name, code) in self.columns:
+			column = getattr(merged, name)
+			column[:self.rows] = array(code, getattr(self, name))
+		merged.replaced = array('l')
+		row = self.rows
+		for i in range(other.rows):
+			j = index.get(other.key(i))
+			if j is None:
+				j = row
+				row += 1
+			else:
+				merged.replaced.append(j)
+			merged.icao[j * ICAO_SIZE:(j + 1) * ICAO_SIZE] = other.icao[i * ICAO_SIZE:(i + 1) * ICAO_SIZE]
+			for (name, code) in self.columns:
+				getattr(merged, name)[j] = getattr(other, name)[i]
+		return merged
+
+	def json(self):
+		return [self.row(i) for i in range(self.rows)]
+
+
+class FacilityStore(object):
+	"""Facility tables for every list type, filled from the dispatch thread.
+
+	add_page() collects the pages of one list; once all dwOutOf of them
+	have arrived the list becomes a FacilityTable that either replaces the
+	stored table (a full RequestFacilitiesList answer) or is merged into it
+	(facilities coming into range of a subscription). listeners are called
+	as listener(kind, table, replaced) after every change.
+	"""
+
+	def __init__(self, path=None):
+		self.path = path
+		self.tables = {kind: FacilityTable(kind) for kind in COLUMNS}
+		self.updated = {kind: threading.Event() for kind in COLUMNS}
+		self.listeners = []
+		self._pages = {}
+		self._map = None
+		if path is not None and os.path.exists(path):
+			try:
+				self.load(path)
+			except (ValueError, OSError) as err:
+				# A bad cache only costs a round of requests; start empty
+				# and overwrite it so the next start is clean.
+				LOGGER.error("Discarding facility cache: %s" % (err))
+				try:
+					self.save(path)
+				except OSError as err:
+					LOGGER.error("Could not rewrite facility cache: %s" % (err))
+
+	def table(self, kind):
+		return self.tables[SIMCONNECT_FACILITY_LIST_TYPE(kind)]
+
+	def find(self, icao):
+		# (kind, row dict) of the first table that knows icao.
+		for kind in (AIRPORT, VOR, NDB, WAYPOINT):
+			row = self.tables[kind].get(icao)
+			if row is not None:
+				return (kind, row)
+		return None
+
+	def add_page(self, kind, List, replace=True):
+		# List is a SIMCONNECT_RECV_FACILITIES_LIST; returns the table once
+		# the last page of its list has arrived, otherwise None.
+		kind = SIMCONNECT_FACILITY_LIST_TYPE(kind)
+		record = RECORDS[kind]
+		size = min(List.dwArraySize * record.size, max(List.dwSize - LIST_HEADER, 0))
+		data = string_at(addressof(List) + LIST_HEADER, size)
+		key = (kind, List.dwRequestID)
+		pages = self._pages.get(key)
+		if pages is None or List.dwEntryNumber == 0:
+			pages = self._pages[key] = {}
+		pages[List.dwEntryNumber] = data
+		if len(pages) < List.dwOutOf:
+			return None
+		del self._pages[key]
+		table = FacilityTable.from_records(kind, b"".join(pages[i] for i in sorted(pages)))
+		if not replace:
+			table = self.tables[kind].merge(table)
+		self.tables[kind] = table
+		self._notify(kind, table, replace)
+		return table
+
+	def _notify(self, kind, table, replaced):
+		self.updated[kind].set()
+		for listener in list(self.listeners):
+			listener(kind, table, replaced)
+
+	def save(self, path=None):
+		# Write to a temporary file first so a crash never leaves half a cache.
+		path = path or self.path
+		self._detach()
+		tmp = path + ".tmp"
+		with open(tmp, "wb") as fp:
+			fp.write(_FILE_HEADER.pack(_FILE_MAGIC, _FILE_VERSION, len(self.tables)))
+			for kind, table in self.tables.items():
+				fp.write(_TABLE_HEADER.pack(int(kind), table.rows))
+				blocks = [bytes(table.icao)] + [array(code, getattr(table, name)).tobytes() for (name, code) in table.columns]
+				for block in blocks:
+					fp.write(b"\0" * (_align(fp.tell()) - fp.tell()))
+					fp.write(block)
+		os.replace(tmp, path)
+
+	def _detach(self):
+		# Copy mapped columns into arrays and unmap, since Windows will not
+		# replace a file that is still mapped.
+		if self._map is None:
+			return
+		for table in self.tables.values():
+			if isinstance(table.icao, memoryview):
+				table.icao = bytearray(table.icao)
+				for (name, code) in table.columns:
+					setattr(table, name, array(code, getattr(table, name)))
+		try:
+			self._map.close()
+		except BufferError:
+			# A caller still holds a mapped table; it stays valid.
+			pass
+		self._map = None
+
+	def load(self, path=None):
+		# Raises ValueError for anything that is not a complete cache of
+		# this version; the store is left as it was.
+		path = path or self.path
+		self._detach()
+		with open(path, "rb") as fp:
+			if os.fstat(fp.fileno()).st_size == 0:
+				raise ValueError("Empty facility cache: %s" % (path))
+			mapped = mmap.mmap(fp.fileno(), 0, access=mmap.ACCESS_READ)
+		view = memoryview(mapped)
+		error = None
+		try:
+			tables = self._read(view)
+		except (ValueError, TypeError, struct.error) as err:
+			error = str(err)
+		if error is not None:
+			# Outside the except block, so no traceback keeps slices of
+			# the mapping alive.
+			view.release()
+			mapped.close()
+			raise ValueError("Not a facility cache: %s (%s)" % (path, error))
+		self.tables.update(tables)
+		self._map = mapped
+		for kind, table in tables.items():
+			self._notify(kind, table, True)
+		return self
+
+	def _read(self, view):
+		(magic, version, count) = _FILE_HEADER.unpack_from(view, 0)
+		if magic != _FILE_MAGIC or version != _FILE_VERSION:
+			raise ValueError("bad magic or version")
+		pos = _FILE_HEADER.size
+		tables = {}
+		for _ in range(count):
+			(kind, rows) = _TABLE_HEADER.unpack_from(view, pos)
+			pos += _TABLE_HEADER.size
+			table = FacilityTable(kind)
+			table.rows = rows
+			pos = _align(pos)
+			table.icao = self._block(view, pos, rows * ICAO_SIZE)
+			pos += rows * ICAO_SIZE
+			for (name, code) in table.columns:
+				pos = _align(pos)
+				nbytes = rows * struct.calcsize(code)
+				setattr(table, name, self._block(view, pos, nbytes).cast(code))
+				pos += nbytes
+			tables[table.kind] = table
+		return tables
+
+	def _block(self, view, pos, nbytes):
+		if pos + nbytes > len(view):
+			raise ValueError("truncated")
+		return view[pos:pos + nbytes]
@@ -0,0 +1,723 @@
+import math
+import struct
+import threading
+import time
+from collections import deque
+from ctypes import *
+from ctypes import _Pointer
+from ctypes.wintypes import *
+from .Enum import *
+from .Constants import *
+from .DataLayout import DATA_OFFSET, DATATYPE_FORMATS
+from .FacilityStore import RECORDS
+
+
+# ----------------------------------------------------------------------------
+#        In-process fake simulator
+#
+# FakeSimConnectDll has the attribute surface of SimConnectDll, but every
+# call is answered by a Python flight model running on a background thread
+# instead of Flight Simulator. It lets SimConnect, AircraftRequests, the
+# bridge and the server run, and be profiled, on machines without MSFS.
+# ----------------------------------------------------------------------------
+
+S_OK = 0
+E_FAIL = -2147467259  # 0x80004005
+
+# Datums whose value is an angle; they are kept in degrees and converted
+# when the definition asks for radians.
+_ANGLES = {
+	b"PLANE LATITUDE",
+	b"PLANE LONGITUDE",
+	b"PLANE HEADING DEGREES TRUE",
+	b"PLANE HEADING DEGREES MAGNETIC",
+	b"PLANE HEADING DEGREES GYRO",
+	b"HEADING INDICATOR",
+	b"PLANE PITCH DEGREES",
+	b"PLANE BANK DEGREES",
+}
+
+
+class FlightModel(object):
+	"""Scripted flight: taxi, takeoff, climb, cruise with turns, descent.
+
+	The script is a loop of (seconds, ground speed kt, vertical speed fpm,
+	turn rate deg/s) phases. Anything not modelled is a plain variable that
+	SetDataOnSimObject can write and later reads return.
+	"""
+
+	script = [
+		(60, 15, 0, 0),
+		(40, 160, 0, 0),
+		(300, 250, 2000, 0),
+		(120, 280, 0, 1.5),
+		(600, 450, 0, 0),
+		(120, 450, 0, -1.5),
+		(300, 280, -1500, 0),
+		(120, 160, -700, 0),
+		(60, 15, 0, 0),
+	]
+
+	def __init__(self, lat=50.0379, lon=8.5622, elevation=364, heading=250, traffic=12, rate=30):
+		self.lat = lat
+		self.lon = lon
+		self.elevation = elevation
+		self.alt = elevation
+		self.heading = heading
+		self.gs = 0.0
+		self.vs = 0.0
+		self.turn = 0.0
+		self.rate = rate
+		self.clock = 0.0
+		self.paused = False
+		self.running = True
+		self.flight = b"Missions\\Fake\\Fake.FLT"
+		self.aircraft = b"SimObjects\\Airplanes\\Fake\\aircraft.cfg"
+		self.events = []
+		self.vars = {
+			b"TITLE": b"Fake Airliner",
+			b"ATC ID": b"FAKE1",
+			b"TRANSPONDER CODE": 0x1200,
+			b"BRAKE PARKING POSITION": 1.0,
+			b"AUTOPILOT MASTER": 0.0,
+			b"FLAPS HANDLE INDEX": 1.0,
+		}
+		self.traffic = [self._spawn(i) for i in range(traffic)]
+
+	def _spawn(self, i):
+		# AI aircraft orbiting the start position at various ranges.
+		return {
+			"id": 2 + i,
+			"range": 0.05 + 0.04 * i,
+			"angle": (i * 37) % 360,
+			"alt": 3000 + 1000 * (i % 10),
+			"gs": 180 + 10 * (i % 8),
+			"lat": self.lat,
+			"lon": self.lon,
+		}
+
+	def phase(self):
+		total = sum(p[0] for p in self.script)
+		t = self.clock % total
+		for phase in self.script:
+			if t < phase[0]:
+				return phase
+			t -= phase[0]
+		return self.script[-1]
+
+	def step(self, dt):
+		if self.paused:
+			return
+		self.clock += dt
+		(_, gs, vs, turn) = self.phase()
+		self.gs += max(-3 * dt, min(3 * dt, gs - self.gs))
+		self.vs = vs
+		self.turn = turn
+		self.alt = max(self.elevation, self.alt + vs / 60.0 * dt)
+		self.heading = (self.heading + turn * dt) % 360
+		nm = self.gs * dt / 3600.0
+		self.lat += nm * math.cos(math.radians(self.heading)) / 60.0
+		self.lon += nm * math.sin(math.radians(self.heading)) / 60.0 / max(0.01, math.cos(math.radians(self.lat)))
+		for ai in self.traffic:
+			ai["angle"] = (ai["angle"] + ai["gs"] * dt / 3600.0 / (ai["range"] * 60) * 57.3) % 360
+			ai["lat"] = self.lat + ai["range"] * math.cos(math.radians(ai["angle"]))
+			ai["lon"] = self.lon + ai["range"] * math.sin(math.radians(ai["angle"]))
+
+	def on_ground(self):
+		return self.alt <= self.elevation + 1
+
+	def value(self, datum, units=None):
+		name = datum.upper()
+		base = name.split(b":", 1)[0]
+		if base in (b"PLANE LATITUDE",):
+			value = self.lat
+		elif base == b"PLANE LONGITUDE":
+			value = self.lon
+		elif base in (b"PLANE ALTITUDE", b"INDICATED ALTITUDE"):
+			value = self.alt
+		elif base == b"PLANE ALT ABOVE GROUND":
+			value = self.alt - self.elevation
+		elif base in (b"AIRSPEED INDICATED", b"AIRSPEED TRUE", b"GROUND VELOCITY"):
+			value = self.gs
+		elif base == b"VERTICAL SPEED":
+			value = self.vs
+		elif base in (b"PLANE HEADING DEGREES TRUE", b"PLANE HEADING DEGREES MAGNETIC", b"PLANE HEADING DEGREES GYRO", b"HEADING INDICATOR"):
+			value = self.heading
+		elif base == b"PLANE PITCH DEGREES":
+			value = -math.degrees(math.atan2(self.vs / 60.0, max(1.0, self.gs * 1.688)))
+		elif base == b"PLANE BANK DEGREES":
+			value = -self.turn * 10
+		elif base == b"SIM ON GROUND":
+			value = float(self.on_ground())
+		elif base == b"GEAR HANDLE POSITION":
+			value = self.vars.get(base, float(self.alt - self.elevation < 1000))
+		elif base in (b"ENG COMBUSTION", b"GENERAL ENG COMBUSTION"):
+			value = 1.0
+		elif base in (b"TURB ENG N1", b"GENERAL ENG PCT MAX RPM"):
+			value = 20.0 + 70.0 * min(1.0, self.gs / 450.0)
+		else:
+			value = self.vars.get(name, self.vars.get(base, 0.0))
+		if base in _ANGLES and units is not None and units.lower().startswith(b"radian"):
+			value = math.radians(value)
+		return value
+
+	def set(self, datum, value, units=None):
+		name = datum.upper()
+		base = name.split(b":", 1)[0]
+		if base in _ANGLES and units is not None and units.lower().startswith(b"radian"):
+			value = math.degrees(value)
+		if base == b"PLANE LATITUDE":
+			self.lat = value
+		elif base == b"PLANE LONGITUDE":
+			self.lon = value
+		elif base == b"PLANE ALTITUDE":
+			self.alt = value
+		elif base == b"PLANE HEADING DEGREES TRUE":
+			self.heading = value
+		else:
+			self.vars[name] = value
+
+	def event(self, name, data):
+		self.events.append((name, data))
+		name = name.upper()
+		if name == b"PARKING_BRAKES":
+			self.vars[b"BRAKE PARKING POSITION"] = 1.0 - self.vars.get(b"BRAKE PARKING POSITION", 0.0)
+		elif name == b"AP_MASTER":
+			self.vars[b"AUTOPILOT MASTER"] = 1.0 - self.vars.get(b"AUTOPILOT MASTER", 0.0)
+		elif name == b"XPNDR_SET":
+			self.vars[b"TRANSPONDER CODE"] = data
+		elif name == b"GEAR_UP":
+			self.vars[b"GEAR HANDLE POSITION"] = 0.0
+		elif name == b"GEAR_DOWN":
+			self.vars[b"GEAR HANDLE POSITION"] = 1.0
+		elif name == b"GEAR_TOGGLE":
+			self.vars[b"GEAR HANDLE POSITION"] = 1.0 - self.value(b"GEAR HANDLE POSITION")
+		elif name == b"FLAPS_INCR":
+			self.vars[b"FLAPS HANDLE INDEX"] = min(5.0, self.vars.get(b"FLAPS HANDLE INDEX", 0.0) + 1)
+		elif name == b"FLAPS_DECR":
+			self.vars[b"FLAPS HANDLE INDEX"] = max(0.0, self.vars.get(b"FLAPS HANDLE INDEX", 0.0) - 1)
+
+	def objects(self, radius):
+		# (object ID, lat, lon) of every aircraft within radius meters.
+		found = [(1, self.lat, self.lon)]
+		for ai in self.traffic:
+			dlat = (ai["lat"] - self.lat) * 111120
+			dlon = (ai["lon"] - self.lon) * 111120 * math.cos(math.radians(self.lat))
+			if math.hypot(dlat, dlon) <= radius:
+				found.append((ai["id"], ai["lat"], ai["lon"]))
+		return found
+
+	def facilities(self, kind, count=2000):
+		# Wire records (see FacilityStore.RECORDS) on a grid around the start
+		# position; the first airport is EDDF.
+		kind = SIMCONNECT_FACILITY_LIST_TYPE(kind)
+		prefix = {0: "A", 1: "W", 2: "N", 3: "V"}[int(kind)]
+		records = []
+		for i in range(count):
+			icao = b"EDDF" if (i == 0 and int(kind) == 0) else ("%s%05d" % (prefix, i)).encode()
+			lat = self.lat + ((i % 50) - 25 * (i > 0)) * 0.2
+			lon = self.lon + ((i // 50) - 20 * (i > 0)) * 0.2
+			values = [icao, lat, lon, float(self.elevation)]
+			if kind >= SIMCONNECT_FACILITY_LIST_TYPE.SIMCONNECT_FACILITY_LIST_TYPE_WAYPOINT:
+				values.append(2.5)
+			if kind >= SIMCONNECT_FACILITY_LIST_TYPE.SIMCONNECT_FACILITY_LIST_TYPE_NDB:
+				values.append(108000000 + 50000 * (i % 200))
+			if kind == SIMCONNECT_FACILITY_LIST_TYPE.SIMCONNECT_FACILITY_LIST_TYPE_VOR:
+				values += [0x7, 250.0, lat, lon, float(self.elevation), 3.0]
+			records.append(values)
+		return records
+
+	def ai_value(self, object_id, datum, units=None):
+		if object_id == 1:
+			return self.value(datum, units)
+		ai = self.traffic[object_id - 2]
+		base = datum.upper().split(b":", 1)[0]
+		value = {
+			b"PLANE LATITUDE": ai["lat"],
+			b"PLANE LONGITUDE": ai["lon"],
+			b"PLANE ALTITUDE": ai["alt"],
+			b"PLANE HEADING DEGREES TRUE": (ai["angle"] + 90) % 360,
+			b"GROUND VELOCITY": ai["gs"],
+			b"AIRSPEED TRUE": ai["gs"],
+			b"ATC ID": ("AI%d" % (object_id)).encode(),
+		}.get(base, 0.0)
+		if base in _ANGLES and units is not None and units.lower().startswith(b"radian"):
+			value = math.radians(value)
+		return value
+
+
+class _Subscription(object):
+
+	def __init__(self, request, define, period, flags, interval):
+		self.request = request
+		self.define = define
+		self.period = period
+		self.flags = flags
+		self.interval = max(1, interval)
+		self.frames = 0
+		self.last = None
+
+
+class FakeSimConnectDll(object):
+	"""Pure-Python stand-in for SimConnectDll driven by a FlightModel.
+
+	Calls return S_OK and queue their replies like the real library; the
+	model thread advances the flight `rate` times per second and queues
+	periodic subscriptions, signalling hEventHandle when it has one.
+	Functions that are not modelled succeed and do nothing.
+	"""
+
+	in_process = True
+
+	def __init__(self, library_path=None, model=None):
+		self.EventID = SIMCONNECT_CLIENT_EVENT_ID
+		self.DATA_DEFINITION_ID = SIMCONNECT_DATA_DEFINITION_ID
+		self.DATA_REQUEST_ID = SIMCONNECT_DATA_REQUEST_ID
+		self.GROUP_ID = SIMCONNECT_NOTIFICATION_GROUP_ID
+		self.INPUT_GROUP_ID = SIMCONNECT_INPUT_GROUP_ID
+		self.CLIENT_DATA_ID = SIMCONNECT_CLIENT_DATA_ID
+		self.CLIENT_DATA_DEFINITION_ID = SIMCONNECT_CLIENT_DATA_DEFINITION_ID
+		self.DispatchProc = CFUNCTYPE(None, POINTER(SIMCONNECT_RECV), DWORD, c_void_p)
+
+		if model is None:
+			model = FlightModel()
+		self.model = model
+		self.rejected = set()
+		self.queue = deque()
+		self.definitions = {}
+		self.subscriptions = {}
+		self.events = {}
+		self.groups = {}
+		self.system_events = {}
+		self.send_id = 0
+		self.event = None
+		self._current = None
+		self._lock = threading.Lock()
+		self._stop = threading.Event()
+		self._thread = None
+
+	def __getattr__(self, name):
+		# Unmodelled SimConnect functions succeed without effect.
+		if name[:1].isupper():
+			return lambda *args: self._sent()
+		raise AttributeError(name)
+
+	# ------------------------------------------------------------------
+	#        Helpers
+	# ------------------------------------------------------------------
+
+	def _sent(self):
+		self.send_id += 1
+		return S_OK
+
+	def _post(self, message):
+		self.queue.append(message)
+		if self.event is not None and hasattr(self.event, "signal"):
+			self.event.signal()
+
+	def _message(self, cls, dwID, **fields):
+		message = cls()
+		message.dwSize = sizeof(cls)
+		message.dwVersion = 4
+		message.dwID = dwID
+		for key, value in fields.items():
+			setattr(message, key, value)
+		return message
+
+	def _exception(self, exception, index=0):
+		self._post(self._message(
+			SIMCONNECT_RECV_EXCEPTION,
+			SIMCONNECT_RECV_ID.SIMCONNECT_RECV_ID_EXCEPTION,
+			dwException=exception,
+			dwSendID=self.send_id,
+			dwIndex=index,
+		))
+
+	def _values(self, define, object_id=1):
+		return [self.model.ai_value(object_id, datum, units) for (datum, units, datatype, epsilon, datum_id) in self.definitions.get(define, [])]
+
+	def _pack(self, define, values):
+		data = b""
+		for (datum, units, datatype, epsilon, datum_id), value in zip(self.definitions.get(define, []), values):
+			if datatype == SIMCONNECT_DATATYPE.SIMCONNECT_DATATYPE_STRINGV:
+				data += _bytes(value) + b"\0"
+				data += b"\0" * (-len(data) % 4)
+				continue
+			fmt = DATATYPE_FORMATS.get(datatype, 'd')
+			if fmt.endswith('s'):
+				value = _bytes(value)
+			elif fmt in ('i', 'q'):
+				value = int(value) if not isinstance(value, bytes) else 0
+			elif isinstance(value, bytes):
+				value = 0.0
+			data += struct.pack('<' + fmt, value)
+		return data
+
+	def _data(self, cls, dwID, request, define, object_id, values, entry=1, outof=1):
+		message = self._message(
+			cls,
+			dwID,
+			dwRequestID=request,
+			dwObjectID=object_id,
+			dwDefineID=define,
+			dwFlags=0,
+			dwentrynumber=entry,
+			dwoutof=outof,
+			dwDefineCount=len(values),
+		)
+		data = self._pack(define, values)
+		memmove(addressof(message) + DATA_OFFSET, data, len(data))
+		return message
+
+	def _changed(self, subscription, values):
+		if subscription.last is None:
+			return True
+		for (deff, old, new) in zip(self.definitions.get(subscription.define, []), subscription.last, values):
+			if isinstance(new, bytes) or isinstance(old, bytes):
+				if new != old:
+					return True
+			elif abs(new - old) > deff[3]:
+				return True
+		return False
+
+	def _tick(self):
+		for subscription in list(self.subscriptions.values()):
+			if subscription.period == SIMCONNECT_PERIOD.SIMCONNECT_PERIOD_SECOND:
+				due = subscription.frames % self.model.rate == 0
+			else:
+				due = subscription.frames % subscription.interval == 0
+			subscription.frames += 1
+			if not due:
+				continue
+			values = self._values(subscription.define)
+			if subscription.flags & SIMCONNECT_DATA_REQUEST_FLAG.SIMCONNECT_DATA_REQUEST_FLAG_CHANGED and not self._changed(subscription, values):
+				continue
+			subscription.last = values
+			self._post(self._data(
+				SIMCONNECT_RECV_SIMOBJECT_DATA,
+				SIMCONNECT_RECV_ID.SIMCONNECT_RECV_ID_SIMOBJECT_DATA,
+				subscription.request,
+				subscription.define,
+				1,
+				values,
+			))
+			if subscription.period == SIMCONNECT_PERIOD.SIMCONNECT_PERIOD_ONCE:
+				self.subscriptions.pop(subscription.request, None)
+
+	def _run(self):
+		dt = 1.0 / self.model.rate
+		next_tick = time.monotonic()
+		while not self._stop.is_set():
+			self.model.step(dt)
+			with self._lock:
+				self._tick()
+			next_tick += dt
+			self._stop.wait(max(0, next_tick - time.monotonic()))
+
+	def _system_event(self, name, data=0):
+		event = self.system_events.get(name)
+		if event is not None:
+			self._post(self._message(
+				SIMCONNECT_RECV_EVENT,
+				SIMCONNECT_RECV_ID.SIMCONNECT_RECV_ID_EVENT,
+				uGroupID=SIMCONNECT_RECV_EVENT.UNKNOWN_GROUP,
+				uEventID=event,
+				dwData=data,
+			))
+
+	# ------------------------------------------------------------------
+	#        SimConnect API
+	# ------------------------------------------------------------------
+
+	def Open(self, phSimConnect, szName, hWnd, UserEventWin32, hEventHandle, ConfigIndex):
+		_target(phSimConnect).value = 1
+		self.event = hEventHandle
+		self.queue.clear()
+		self.definitions = {}
+		self.subscriptions = {}
+		self.events = {}
+		self.groups = {}
+		self.system_events = {}
+		self._post(self._message(SIMCONNECT_RECV_OPEN, SIMCONNECT_RECV_ID.SIMCONNECT_RECV_ID_OPEN))
+		self._stop.clear()
+		self._thread = threading.Thread(target=self._run, name="fake-simconnect")
+		self._thread.daemon = True
+		self._thread.start()
+		return S_OK
+
+	def Close(self, hSimConnect):
+		self._stop.set()
+		if self._thread is not None and self._thread is not threading.current_thread():
+			self._thread.join()
+		self._thread = None
+		return S_OK
+
+	def quit(self):
+		# Simulate the sim shutting down.
+		self._post(self._message(SIMCONNECT_RECV, SIMCONNECT_RECV_ID.SIMCONNECT_RECV_ID_QUIT))
+
+	def cockpit(self, name, data=0):
+		# Simulate the pilot triggering key event name, e.g. b"XPNDR_SET".
+		self.model.event(name, data)
+		self._notify(name, data)
+
+	def _notify(self, name, data):
+		# Report a key event to every group that has one of its client IDs.
+		for (event, mapped) in list(self.events.items()):
+			group = self.groups.get(event)
+			if group is not None and mapped.upper() == name.upper():
+				self._post(self._message(
+					SIMCONNECT_RECV_EVENT,
+					SIMCONNECT_RECV_ID.SIMCONNECT_RECV_ID_EVENT,
+					uGroupID=group,
+					uEventID=event,
+					dwData=data,
+				))
+
+	def _filename_event(self, name, path):
+		event = self.system_events.get(name)
+		if event is not None:
+			self._post(self._message(
+				SIMCONNECT_RECV_EVENT_FILENAME,
+				SIMCONNECT_RECV_ID.SIMCONNECT_RECV_ID_EVENT_FILENAME,
+				uGroupID=SIMCONNECT_RECV_EVENT.UNKNOWN_GROUP,
+				uEventID=event,
+				zFileName=path,
+			))
+
+	def pause(self, paused=True):
+		self.model.paused = paused
+		self._system_event(b"Paused" if paused else b"Unpaused")
+		self._system_event(b"Pause_EX1", 1 if paused else 0)
+
+	def run(self, running=True):
+		# Simulate entering (True) or leaving (False) a flight.
+		self.model.running = running
+		self._system_event(b"SimStart" if running else b"SimStop")
+		self._system_event(b"Sim", 1 if running else 0)
+
+	def crash(self):
+		self._system_event(b"Crashed")
+
+	def crash_reset(self):
+		self._system_event(b"CrashReset")
+
+	def load(self, flight=None, aircraft=None):
+		# Simulate loading a flight and/or aircraft file.
+		if flight is not None:
+			self.model.flight = flight
+			self._filename_event(b"FlightLoaded", flight)
+		if aircraft is not None:
+			self.model.aircraft = aircraft
+			self._filename_event(b"AircraftLoaded", aircraft)
+
+	def GetLastSentPacketID(self, hSimConnect, pdwSendID):
+		_target(pdwSendID).value = self.send_id
+		return S_OK
+
+	def GetNextDispatch(self, hSimConnect, ppData, pcbData):
+		try:
+			message = self.queue.popleft()
+		except IndexError:
+			return E_FAIL
+		self._current = message
+		_target(ppData).contents = message
+		_target(pcbData).value = sizeof(message)
+		return S_OK
+
+	def CallDispatch(self, hSimConnect, pfcnDispatch, pContext):
+		while self.queue:
+			message = self.queue.popleft()
+			pfcnDispatch(cast(pointer(message), POINTER(SIMCONNECT_RECV)), sizeof(message), pContext)
+		return S_OK
+
+	def SubscribeToSystemEvent(self, hSimConnect, EventID, SystemEventName):
+		self.system_events[SystemEventName] = int(EventID)
+		self._sent()
+		if SystemEventName == b"SimStart":
+			self._system_event(SystemEventName)
+		return S_OK
+
+	def RequestSystemState(self, hSimConnect, RequestID, szState):
+		self._sent()
+		state = {
+			b"Sim": (int(self.model.running), b""),
+			b"FlightLoaded": (0, self.model.flight),
+			b"AircraftLoaded": (0, self.model.aircraft),
+		}.get(szState)
+		if state is None:
+			self._exception(SIMCONNECT_EXCEPTION.SIMCONNECT_EXCEPTION_NAME_UNRECOGNIZED, 3)
+			return S_OK
+		self._post(self._message(
+			SIMCONNECT_RECV_SYSTEM_STATE,
+			SIMCONNECT_RECV_ID.SIMCONNECT_RECV_ID_SYSTEM_STATE,
+			dwRequestID=int(RequestID),
+			dwInteger=state[0],
+			szString=state[1],
+		))
+		return S_OK
+
+	def UnsubscribeFromSystemEvent(self, hSimConnect, EventID):
+		for name, event in list(self.system_events.items()):
+			if event == int(EventID):
+				del self.system_events[name]
+		return self._sent()
+
+	def AddToDataDefinition(self, hSimConnect, DefineID, DatumName, UnitsName, DatumType=SIMCONNECT_DATATYPE.SIMCONNECT_DATATYPE_FLOAT64, fEpsilon=0, DatumID=SIMCONNECT_UNUSED):
+		self._sent()
+		if DatumName in self.rejected:
+			self._exception(SIMCONNECT_EXCEPTION.SIMCONNECT_EXCEPTION_NAME_UNRECOGNIZED, 3)
+			return S_OK
+		with self._lock:
+			self.definitions.setdefault(int(DefineID), []).append((DatumName, UnitsName, DatumType, float(fEpsilon), DatumID))
+		return S_OK
+
+	def ClearDataDefinition(self, hSimConnect, DefineID):
+		with self._lock:
+			self.definitions.pop(int(DefineID), None)
+		return self._sent()
+
+	def RequestDataOnSimObject(self, hSimConnect, RequestID, DefineID, ObjectID, Period, Flags=0, origin=0, interval=0, limit=0):
+		self._sent()
+		if int(DefineID) not in self.definitions:
+			self._exception(SIMCONNECT_EXCEPTION.SIMCONNECT_EXCEPTION_UNRECOGNIZED_ID, 3)
+			return S_OK
+		with self._lock:
+			if int(Period) == SIMCONNECT_PERIOD.SIMCONNECT_PERIOD_NEVER:
+				self.subscriptions.pop(int(RequestID), None)
+			else:
+				self.subscriptions[int(RequestID)] = _Subscription(int(RequestID), int(DefineID), int(Period), int(Flags), int(interval) + 1)
+		return S_OK
+
+	def RequestDataOnSimObjectType(self, hSimConnect, RequestID, DefineID, dwRadiusMeters, type):
+		self._sent()
+		if int(DefineID) not in self.definitions:
+			self._exception(SIMCONNECT_EXCEPTION.SIMCONNECT_EXCEPTION_UNRECOGNIZED_ID, 3)
+			return S_OK
+		with self._lock:
+			if int(type) == SIMCONNECT_SIMOBJECT_TYPE.SIMCONNECT_SIMOBJECT_TYPE_USER:
+				objects = [(1, None, None)]
+			else:
+				objects = self.model.objects(int(dwRadiusMeters))
+			for entry, (object_id, lat, lon) in enumerate(objects):
+				self._post(self._data(
+					SIMCONNECT_RECV_SIMOBJECT_DATA_BYTYPE,
+					SIMCONNECT_RECV_ID.SIMCONNECT_RECV_ID_SIMOBJECT_DATA_BYTYPE,
+					int(RequestID),
+					int(DefineID),
+					object_id,
+					self._values(int(DefineID), object_id),
+					entry + 1,
+					len(objects),
+				))
+		return S_OK
+
+	def SetDataOnSimObject(self, hSimConnect, DefineID, ObjectID, Flags, ArrayCount, cbUnitSize, pDataSet):
+		self._sent()
+		definition = self.definitions.get(int(DefineID), [])
+		data = string_at(pDataSet, cbUnitSize)
+		if int(Flags) & SIMCONNECT_DATA_SET_FLAG.SIMCONNECT_DATA_SET_FLAG_TAGGED:
+			# Tagged: (DatumID, value) pairs.
+			by_id = {deff[4]: deff for deff in definition}
+			offset = 0
+			while offset + 4 <= len(data):
+				(datum_id,) = struct.unpack_from('<I', data, offset)
+				offset += 4
+				deff = by_id.get(datum_id)
+				if deff is None:
+					break
+				fmt = '<' + DATATYPE_FORMATS.get(deff[2], 'd')
+				(value,) = struct.unpack_from(fmt, data, offset)
+				offset += struct.calcsize(fmt)
+				self.model.set(deff[0], value, deff[1])
+			return S_OK
+		offset = 0
+		for (datum, units, datatype, epsilon, datum_id) in definition:
+			if datatype == SIMCONNECT_DATATYPE.SIMCONNECT_DATATYPE_STRINGV:
+				self.model.set(datum, data[offset:].split(b"\0", 1)[0], units)
+				break
+			fmt = '<' + DATATYPE_FORMATS.get(datatype, 'd')
+			if offset + struct.calcsize(fmt) > len(data):
+				break
+			(value,) = struct.unpack_from(fmt, data, offset)
+			offset += struct.calcsize(fmt)
+			if fmt.endswith('s'):
+				value = value.split(b"\0", 1)[0]
+			self.model.set(datum, value, units)
+		return S_OK
+
+	def RequestFacilitiesList(self, hSimConnect, ListType, RequestID, page=256):
+		# The whole list, chopped into pages like the sim does.
+		self._sent()
+		kind = SIMCONNECT_FACILITY_LIST_TYPE(int(ListType))
+		record = RECORDS[kind]
+		records = self.model.facilities(kind)
+		recv_id = {
+			0: SIMCONNECT_RECV_ID.SIMCONNECT_RECV_ID_AIRPORT_LIST,
+			1: SIMCONNECT_RECV_ID.SIMCONNECT_RECV_ID_WAYPOINT_LIST,
+			2: SIMCONNECT_RECV_ID.SIMCONNECT_RECV_ID_NDB_LIST,
+			3: SIMCONNECT_RECV_ID.SIMCONNECT_RECV_ID_VOR_LIST,
+		}[int(kind)]
+		pages = [records[i:i + page] for i in range(0, len(records), page)] or [[]]
+		for (entry, rows) in enumerate(pages):
+			data = b"".join(record.pack(*values) for values in rows)
+			cls = type("SIMCONNECT_RECV_FACILITIES_PAGE", (SIMCONNECT_RECV_FACILITIES_LIST,), {
+				"_fields_": [("rgData", c_ubyte * max(len(data), 1))],
+			})
+			message = self._message(
+				cls,
+				recv_id,
+				dwRequestID=int(RequestID),
+				dwArraySize=len(rows),
+				dwEntryNumber=entry,
+				dwOutOf=len(pages),
+			)
+			memmove(addressof(message) + sizeof(SIMCONNECT_RECV_FACILITIES_LIST), data, len(data))
+			self._post(message)
+		return S_OK
+
+	def MapClientEventToSimEvent(self, hSimConnect, EventID, EventName=b""):
+		self.events[int(EventID)] = EventName
+		return self._sent()
+
+	def AddClientEventToNotificationGroup(self, hSimConnect, GroupID, EventID, bMaskable=False):
+		self.groups[int(EventID)] = int(GroupID)
+		return self._sent()
+
+	def ClearNotificationGroup(self, hSimConnect, GroupID):
+		for (event, group) in list(self.groups.items()):
+			if group == int(GroupID):
+				del self.groups[event]
+		return self._sent()
+
+	def TransmitClientEvent(self, hSimConnect, ObjectID, EventID, dwData, GroupID, Flags):
+		self._sent()
+		name = self.events.get(int(EventID))
+		if name is None:
+			self._exception(SIMCONNECT_EXCEPTION.SIMCONNECT_EXCEPTION_UNRECOGNIZED_ID, 2)
+			return S_OK
+		if isinstance(dwData, DWORD):
+			dwData = dwData.value
+		if name.upper() in (b"PAUSE_ON", b"PAUSE_OFF", b"PAUSE_TOGGLE"):
+			self.pause({b"PAUSE_ON": True, b"PAUSE_OFF": False}.get(name.upper(), not self.model.paused))
+		self.model.event(name, dwData)
+		self._notify(name, dwData)
+		return S_OK
+
+
+def _target(arg):
+	# Unwrap byref()/pointer() arguments to the object they refer to.
+	obj = getattr(arg, "_obj", None)
+	if obj is not None:
+		return obj
+	if isinstance(arg, _Pointer):
+		return arg.contents
+	return arg
+
+
+def _bytes(value):
+	if isinstance(value, bytes):
+		return value
+	if isinstance(value, str):
+		return value.encode()
+	return str(value).encode()
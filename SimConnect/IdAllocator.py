@@ -0,0 +1,66 @@
+import threading
+
+
+class ClientId(int):
+	"""Client-defined SimConnect ID.
+
+	Behaves as a plain int for ctypes and keeps the .value/.name interface of
+	the Enum members that used to be generated for every allocation.
+	"""
+
+	def __new__(cls, value, name=None):
+		obj = int.__new__(cls, value)
+		obj.name = name
+		return obj
+
+	@property
+	def value(self):
+		return int(self)
+
+
+class IdAllocator(object):
+	"""O(1) integer ID allocator with free-list recycling.
+
+	IDs below start are reserved for the static members of the matching
+	Enum (e.g. EVENT_SIM_START). Released IDs are handed out again before
+	new ones, so the ID space stays bounded by the peak number in use.
+	Releasing an ID that is not in use raises ValueError instead of putting
+	it on the free list a second time.
+	"""
+
+	def __init__(self, start=0, prefix="Id"):
+		self.start = start
+		self.prefix = prefix
+		self.next = start
+		self.free = []
+		self.used = set()
+		self.lock = threading.Lock()
+
+	def acquire(self, name=None):
+		with self.lock:
+			if self.free:
+				value = self.free.pop()
+			else:
+				value = self.next
+				self.next += 1
+			self.used.add(value)
+		if name is None:
+			name = self.prefix + str(value)
+		return ClientId(value, name)
+
+	def release(self, value):
+		value = int(value)
+		with self.lock:
+			if value not in self.used:
+				raise ValueError("%s%d is not in use" % (self.prefix, value))
+			self.used.remove(value)
+			self.free.append(value)
+
+	def reset(self):
+		with self.lock:
+			self.next = self.start
+			self.free = []
+			self.used = set()
+
+	def __len__(self):
+		return len(self.used)
@@ -1,6 +1,8 @@
 from SimConnect import *
 from .Enum import *
 from .Constants import *
+from .DefinitionGroup import DefinitionGroup, WritableGroup
+from .Deadband import epsilon_for
 
 
 class Request(object):
@@ -31,7 +33,7 @@ class Request(object):
 			self.sm.set_data(self)
 			# self.sm.run()
 
-	def __init__(self, _deff, _sm, _time=10, _dec=None, _settable=False, _attemps=10):
+	def __init__(self, _deff, _sm, _time=10, _dec=None, _settable=False, _attemps=10, _epsilon=0):
 		self.DATA_DEFINITION_ID = None
 		self.definitions = []
 		self.description = _dec
@@ -43,8 +45,11 @@ class Request(object):
 		self.time = _time
 		self.defined = False
 		self.settable = _settable
+		self.epsilon = _epsilon
 		self.LastData = 0
 		self.LastID = 0
+		self.exceptions = 0
+		self.disabled = False
 		if ':index' in str(self.definitions[0][0]):
 			self.lastIndex = b':index'
 
@@ -58,6 +63,8 @@ class Request(object):
 		dec = dec.replace(self.lastIndex, newindex)
 		self.lastIndex = newindex
 		self.definitions[0] = (dec, stype)
+		self.exceptions = 0
+		self.disabled = False
 		self.redefine()
 		return True
 
@@ -73,10 +80,31 @@ class Request(object):
 			# self.sm.run()
 			self.sm.get_data(self)
 
+	def on_exception(self, exception, datum):
+		# Called from the dispatch thread for every exception raised by one
+		# of this request's packets.
+		self.exceptions += 1
+		LOGGER.warning("%s: in %s" % (exception.name, self.definitions[0]))
+		if self.exceptions >= self.sm.exception_limit and not self.disabled:
+			LOGGER.error("Disabled after %d exceptions: %s" % (self.exceptions, self.definitions[0]))
+			self.disabled = True
+
+	def release(self):
+		# Clear the definition and hand both IDs back for reuse.
+		if self.DATA_DEFINITION_ID is None:
+			return
+		self.sm.release_def_id(self.DATA_DEFINITION_ID)
+		self.sm.release_request_id(self.DATA_REQUEST_ID)
+		self.DATA_DEFINITION_ID = None
+		self.DATA_REQUEST_ID = None
+		self.defined = False
+
 	def _deff_test(self):
 		if ':index' in str(self.definitions[0][0]):
 			self.lastIndex = b':index'
 			return False
+		if self.disabled:
+			return False
 		if self.defined is True:
 			return True
 		if self.DATA_DEFINITION_ID is None:
@@ -87,9 +115,11 @@ class Request(object):
 
 		rtype = self.definitions[0][1]
 		DATATYPE = SIMCONNECT_DATATYPE.SIMCONNECT_DATATYPE_FLOAT64
+		epsilon = self.epsilon
 		if 'String' in rtype.decode() or 'string' in rtype.decode():
 			rtype = None
 			DATATYPE = SIMCONNECT_DATATYPE.SIMCONNECT_DATATYPE_STRINGV
+			epsilon = 0
 
 		err = self.sm.dll.AddToDataDefinition(
 			self.sm.hSimConnect,
@@ -97,14 +127,12 @@ class Request(object):
 			self.definitions[0][0],
 			rtype,
 			DATATYPE,
-			0,
+			epsilon,
 			SIMCONNECT_UNUSED,
 		)
 		if self.sm.IsHR(err, 0):
 			self.defined = True
-			temp = DWORD(0)
-			self.sm.dll.GetLastSentPacketID(self.sm.hSimConnect, temp)
-			self.LastID = temp.value
+			self.LastID = self.sm.track(self, self.definitions[0][0])
 			return True
 		else:
 			LOGGER.error("SIM def" + str(self.definitions[0]))
@@ -112,11 +140,12 @@ class Request(object):
 
 
 class RequestHelper:
-	def __init__(self, _sm, _time=10, _attemps=10):
+	def __init__(self, _sm, _time=10, _attemps=10, _epsilon=None):
 		self.sm = _sm
 		self.dic = []
 		self.time = _time
 		self.attemps = _attemps
+		self.epsilon = _epsilon
 
 	def __getattribute__(self, _name):
 		return super().__getattribute__(_name)
@@ -127,7 +156,7 @@ class RequestHelper:
 			setable = False
 			if key[3] == 'Y':
 				setable = True
-			ne = Request((key[1], key[2]), self.sm, _dec=key[0], _settable=setable, _time=self.time, _attemps=self.attemps)
+			ne = Request((key[1], key[2]), self.sm, _dec=key[0], _settable=setable, _time=self.time, _attemps=self.attemps, _epsilon=epsilon_for(_name, self.epsilon))
 			setattr(self, _name, ne)
 			return ne
 		return None
@@ -161,19 +190,60 @@ class RequestHelper:
 
 class AircraftRequests():
 	def find(self, key):
+		# "NAME:2" gets its own cached Request per concrete index, so reading
+		# :1 and :2 in turn never redefines anything. "NAME:index" is the
+		# template and cannot be read.
 		index = None
 		if ':' in key:
 			(keyname, index) = key.split(":", 1)
+			if index == "index":
+				index = None
+			else:
+				rqest = self.indexed.get(key)
+				if rqest is not None:
+					return rqest
 			key = "%s:index" % (keyname)
 
 		for clas in self.list:
 			if key in clas.list:
-				rqest = getattr(clas, key)
-				if index is not None:
-					rqest.setIndex(index)
-				return rqest
+				if index is None:
+					return getattr(clas, key)
+				return self._indexed(clas, key, index)
 		return None
 
+	def _indexed(self, clas, key, index):
+		entry = clas.list[key]
+		concrete = "%s:%s" % (key.split(":", 1)[0], index)
+		rqest = Request(
+			(entry[1].replace(b':index', str(":" + str(index)).encode()), entry[2]),
+			self.sm,
+			_dec=entry[0],
+			_settable=entry[3] == 'Y',
+			_time=clas.time,
+			_attemps=clas.attemps,
+			_epsilon=epsilon_for(concrete, clas.epsilon),
+		)
+		# Another thread may have won the race; its Request is the one kept.
+		return self.indexed.setdefault(concrete, rqest)
+
+	def array(self, key, count=4):
+		# One DefinitionGroup reading NAME:1 .. NAME:count together, e.g. a
+		# value for every engine in one request. Cached per (name, count).
+		keyname = key.split(":", 1)[0]
+		group = self.arrays.get((keyname, count))
+		if group is None:
+			keys = ["%s:%d" % (keyname, i) for i in range(1, count + 1)]
+			group = self.arrays.setdefault((keyname, count), self.group(keys))
+		return group
+
+	def get_array(self, key, count=4):
+		# [value of NAME:1, ..., NAME:count], or None if the read failed.
+		group = self.array(key, count)
+		snapshot = group.value
+		if snapshot is None:
+			return None
+		return [snapshot.get(k) for k in group.keys]
+
 	def get(self, key):
 		request = self.find(key)
 		if request is None:
@@ -187,8 +257,114 @@ class AircraftRequests():
 		request.value = _value
 		return True
 
-	def __init__(self, _sm, _time=10, _attemps=10):
+	def get_many(self, keys):
+		# Like get() for every key, but all stale requests are in flight at
+		# once and awaited together.
+		requests = {}
+		for key in keys:
+			requests[key] = self.find(key)
+
+		stale = []
+		for request in requests.values():
+			if request is None or request in stale or not request._deff_test():
+				continue
+			if (request.LastData + request.time) < millis():
+				stale.append(request)
+
+		failed = []
+		for request, ok in zip(stale, self.sm.get_many(stale)):
+			if ok:
+				request.LastData = millis()
+			else:
+				failed.append(request)
+
+		values = {}
+		for key, request in requests.items():
+			if request is None or not request.defined or request in failed:
+				values[key] = None
+			else:
+				values[key] = request.outData
+		return values
+
+	def definition(self, key):
+		# Resolve a key such as "TURB_ENG_N1:2" to its (datum, units, settable)
+		# catalog entry without creating a Request.
+		index = None
+		if ':' in key:
+			(keyname, index) = key.split(":", 1)
+			key = "%s:index" % (keyname)
+
+		for clas in self.list:
+			if key in clas.list:
+				entry = clas.list[key]
+				datum = entry[1]
+				if index is not None:
+					datum = datum.replace(b':index', str(":" + str(index)).encode())
+				return (datum, entry[2], entry[3] == 'Y')
+		return None
+
+	def group(self, keys, _time=None, _attemps=None, _types=None, _epsilon=None, _cls=DefinitionGroup):
+		# _types optionally maps keys to a SIMCONNECT_DATATYPE, e.g. INT32 for
+		# flags and enums, instead of the FLOAT64/STRING256 default. _epsilon
+		# overrides deadbands for this group on top of the consumer's own.
+		fields = []
+		for key in keys:
+			deff = self.definition(key)
+			if deff is None:
+				LOGGER.warning("Unknown simvar: %s" % (key))
+				continue
+			if _types is not None and key in _types:
+				fields.append((key, deff[0], deff[1], _types[key]))
+			else:
+				fields.append((key, deff[0], deff[1]))
+		if _time is None:
+			_time = self.time
+		if _attemps is None:
+			_attemps = self.attemps
+		epsilon = self.epsilon
+		if _epsilon:
+			epsilon = dict(self.epsilon or {}, **_epsilon)
+		return _cls(fields, self.sm, _time=_time, _attemps=_attemps, _epsilon=epsilon)
+
+	def writable(self, keys, _types=None):
+		# WritableGroup over the settable keys ('Y' in the catalog); the
+		# others are left out with a warning.
+		settable = []
+		for key in keys:
+			deff = self.definition(key)
+			if deff is not None and not deff[2]:
+				LOGGER.warning("Not settable: %s" % (key))
+				continue
+			settable.append(key)
+		return self.group(settable, _types=_types, _cls=WritableGroup)
+
+	def set_time(self, _time):
+		# Change the cache age of every request, existing ones included.
+		self.time = _time
+		for clas in self.list:
+			clas.time = _time
+			for request in vars(clas).values():
+				if isinstance(request, Request):
+					request.time = _time
+		for request in list(self.indexed.values()):
+			request.time = _time
+		for group in list(self.arrays.values()):
+			group.time = _time
+
+	def subscribe(self, keys, period=SIMCONNECT_PERIOD.SIMCONNECT_PERIOD_SIM_FRAME, changed=False, _epsilon=None):
+		# Group the keys and let the sim push them into sm.store.
+		group = self.group(keys, _epsilon=_epsilon)
+		group.subscribe(period, changed)
+		return group
+
+	def __init__(self, _sm, _time=10, _attemps=10, _epsilon=None):
+		# _epsilon: per-consumer deadband overrides, see Deadband.py.
 		self.sm = _sm
+		self.time = _time
+		self.attemps = _attemps
+		self.epsilon = _epsilon
+		self.indexed = {}
+		self.arrays = {}
 		self.list = []
 		self.EngineData = self.__AircraftEngineData(_sm, _time, _attemps)
 		self.list.append(self.EngineData)
@@ -230,6 +406,8 @@ class AircraftRequests():
 		self.list.append(self.EnvironmentData)
 		self.SlingsandHoists = self.__SlingsandHoists(_sm, _time, _attemps)
 		self.list.append(self.SlingsandHoists)
+		for clas in self.list:
+			clas.epsilon = _epsilon
 
 	class __AircraftEngineData(RequestHelper):
 		list = {
@@ -0,0 +1,151 @@
+import os
+import sys
+from ctypes import *
+from ctypes.wintypes import *
+from .Enum import *
+from .Constants import *
+
+
+# ----------------------------------------------------------------------------
+#        Batched dispatch
+#
+# A ring drains every queued message into one preallocated buffer per
+# wakeup and returns how many it copied; record i is sizes[i] bytes at
+# offsets[i], a verbatim copy of the SIMCONNECT_RECV message. NativeRing
+# does the draining in native/ringdrain.c, PyRing does the same through
+# ctypes and yields an identical buffer.
+#
+# SIMCONNECT_RING=native|python|off picks one; by default the native ring
+# is used when the library has been built and the backend is the real DLL.
+# In-process backends dispatch message by message unless a ring is asked
+# for; native then calls back into the backend through a C function
+# pointer, which lets both rings be compared over the fake sim's queue.
+# ----------------------------------------------------------------------------
+
+RING_ENV = "SIMCONNECT_RING"
+
+_native_dir = os.path.join(os.path.dirname(os.path.abspath(__file__)), "native")
+_native_names = ["ringdrain.dll"] if sys.platform == "win32" else ["libringdrain.so", "libringdrain.dylib"]
+
+# next_dispatch_fn of ringdrain.c.
+_FUNCTYPE = WINFUNCTYPE if sys.platform == "win32" else CFUNCTYPE
+NEXT_DISPATCH = _FUNCTYPE(c_int32, c_void_p, POINTER(c_void_p), POINTER(c_uint32))
+
+
+class PyRing(object):
+	"""Batch buffer filled through ctypes calls to GetNextDispatch."""
+
+	def __init__(self, capacity=1 << 20, max_records=4096):
+		# Room for the largest message past the last record, so a message
+		# is never dequeued without space to copy it.
+		self.reserve = max(65536, sizeof(SIMCONNECT_RECV_SIMOBJECT_DATA))
+		self.capacity = capacity + self.reserve
+		self.max_records = max_records
+		self.buffer = (c_ubyte * (self.capacity + self.reserve))()
+		self.address = addressof(self.buffer)
+		self.offsets = (c_uint32 * max_records)()
+		self.sizes = (c_uint32 * max_records)()
+		self.count = 0
+
+	def drain(self, _sm):
+		count = 0
+		pos = 0
+		pData = POINTER(SIMCONNECT_RECV)()
+		cbData = DWORD(0)
+		while count < self.max_records and self.capacity - pos >= self.reserve:
+			try:
+				hr = _sm.dll.GetNextDispatch(_sm.hSimConnect, byref(pData), byref(cbData))
+			except OSError:
+				break
+			if not _sm.IsHR(hr, 0) or not pData:
+				break
+			size = min(cbData.value, self.reserve)
+			memmove(self.address + pos, pData, size)
+			self.offsets[count] = pos
+			self.sizes[count] = size
+			count += 1
+			pos += (size + 7) & ~7
+		self.count = count
+		return count
+
+
+class NativeRing(PyRing):
+	"""Batch buffer filled by ring_drain() from native/ringdrain.c."""
+
+	def __init__(self, lib, next_dispatch, capacity=1 << 20, max_records=4096):
+		# next_dispatch is the address of SimConnect_GetNextDispatch or a
+		# NEXT_DISPATCH callback, which is kept alive here.
+		super().__init__(capacity, max_records)
+		if isinstance(next_dispatch, NEXT_DISPATCH):
+			self.callback = next_dispatch
+			next_dispatch = cast(next_dispatch, c_void_p).value
+		self.lib = lib
+		self.lib.ring_drain.restype = c_uint32
+		self.lib.ring_drain.argtypes = [
+			c_void_p,
+			c_void_p,
+			c_void_p,
+			c_uint32,
+			c_uint32,
+			POINTER(c_uint32),
+			POINTER(c_uint32),
+			c_uint32,
+		]
+		self.next_dispatch = next_dispatch
+
+	def drain(self, _sm):
+		self.count = self.lib.ring_drain(
+			self.next_dispatch,
+			_sm.hSimConnect,
+			self.address,
+			self.capacity,
+			self.reserve,
+			self.offsets,
+			self.sizes,
+			self.max_records,
+		)
+		return self.count
+
+
+def in_process_next_dispatch(dll):
+	# NEXT_DISPATCH callback over an in-process backend's GetNextDispatch.
+	def next_dispatch(handle, ppData, pcbData):
+		pData = POINTER(SIMCONNECT_RECV)()
+		cbData = DWORD(0)
+		hr = dll.GetNextDispatch(handle, byref(pData), byref(cbData))
+		if (hr & 0xFFFFFFFF) != 0 or not pData:
+			return -1
+		ppData[0] = cast(pData, c_void_p).value
+		pcbData[0] = cbData.value
+		return 0
+	return NEXT_DISPATCH(next_dispatch)
+
+
+def load_native(directory=None):
+	for name in _native_names:
+		path = os.path.join(directory or _native_dir, name)
+		if os.path.exists(path):
+			try:
+				return CDLL(path)
+			except OSError as err:
+				LOGGER.warning("Could not load %s: %s" % (path, err))
+	return None
+
+
+def default_ring(dll):
+	# Ring for this backend, or None to dispatch message by message.
+	mode = os.environ.get(RING_ENV, "").lower()
+	if mode == "off":
+		return None
+	if mode == "python":
+		return PyRing()
+	in_process = getattr(dll, "in_process", False)
+	if in_process and mode != "native":
+		return None
+	lib = load_native()
+	if lib is None:
+		return None
+	if in_process:
+		return NativeRing(lib, in_process_next_dispatch(dll))
+	next_dispatch = cast(dll.SimConnect.SimConnect_GetNextDispatch, c_void_p).value
+	return NativeRing(lib, next_dispatch)
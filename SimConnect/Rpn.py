@@ -0,0 +1,370 @@
+import json
+import math
+import re
+
+
+# ----------------------------------------------------------------------------
+#        MSFS RPN (calculator code) compiler
+#
+# Read-only expressions such as the SimConnectValue of a MobiFlight output,
+#   (L:A32NX_OVHD_INTLT_ANN,Number) 2 == if{ 0.1 } els{ 1 } *
+# are compiled once: the token stream is run against a symbolic stack that
+# builds one Python expression, which is turned into a single function of
+# the engine's variable slots. Evaluating an output is then one call.
+# ----------------------------------------------------------------------------
+
+_TOKEN = re.compile(r"\(>[^)]*\)|\([^)]*\)|if\{|els\{|\}|\S+")
+
+_BINARY = {
+	"+": "({0} + {1})",
+	"-": "({0} - {1})",
+	"*": "({0} * {1})",
+	"/": "_div({0}, {1})",
+	"%": "_mod({0}, {1})",
+	"==": "({0} == {1})",
+	"!=": "({0} != {1})",
+	"<": "({0} < {1})",
+	">": "({0} > {1})",
+	"<=": "({0} <= {1})",
+	">=": "({0} >= {1})",
+	"and": "({0} != 0 and {1} != 0)",
+	"&&": "({0} != 0 and {1} != 0)",
+	"or": "({0} != 0 or {1} != 0)",
+	"||": "({0} != 0 or {1} != 0)",
+	"&": "(int({0}) & int({1}))",
+	"|": "(int({0}) | int({1}))",
+	"^": "(int({0}) ^ int({1}))",
+	"<<": "(int({0}) << int({1}))",
+	">>": "(int({0}) >> int({1}))",
+	"min": "min({0}, {1})",
+	"max": "max({0}, {1})",
+	"pow": "_pow({0}, {1})",
+}
+
+_UNARY = {
+	"!": "({0} == 0)",
+	"not": "({0} == 0)",
+	"~": "(~int({0}))",
+	"neg": "(-{0})",
+	"abs": "abs({0})",
+	"flr": "_floor({0})",
+	"ceil": "_ceil({0})",
+	"near": "round({0})",
+	"int": "float(int({0}))",
+	"sqrt": "_sqrt({0})",
+}
+
+
+def _div(a, b):
+	return a / b if b else 0.0
+
+
+def _mod(a, b):
+	return a % b if b else 0.0
+
+
+def _pow(a, b):
+	try:
+		return float(a) ** b
+	except (OverflowError, ZeroDivisionError):
+		return 0.0
+
+
+def _floor(a):
+	return float(math.floor(a))
+
+
+def _ceil(a):
+	return float(math.ceil(a))
+
+
+def _sqrt(a):
+	return a ** .5 if a > 0 else 0.0
+
+
+_GLOBALS = {
+	"__builtins__": {},
+	"abs": abs,
+	"min": min,
+	"max": max,
+	"round": round,
+	"int": int,
+	"float": float,
+	"_div": _div,
+	"_mod": _mod,
+	"_pow": _pow,
+	"_floor": _floor,
+	"_ceil": _ceil,
+	"_sqrt": _sqrt,
+}
+
+
+class RpnError(ValueError):
+	pass
+
+
+def parse_var(token):
+	# "(L:A32NX_OVHD_INTLT_ANN, Number)" -> ("L:A32NX_OVHD_INTLT_ANN", "Number")
+	body = token[1:-1]
+	if "," in body:
+		(name, units) = body.split(",", 1)
+		units = units.strip() or None
+	else:
+		(name, units) = (body, None)
+	return (name.strip(), units)
+
+
+def var_expression(name, units=None):
+	# Calculator code that reads one variable, e.g. for ClientDataChannel.
+	if units:
+		return "(%s, %s)" % (name, units)
+	return "(%s)" % (name)
+
+
+class _Compiler(object):
+
+	def __init__(self, slot):
+		self.slot = slot
+		self.registers = {}
+
+	def run(self, tokens, pos, stack, closing=False):
+		# Returns the index after the block; stops at a closing brace.
+		while pos < len(tokens):
+			token = tokens[pos]
+			pos += 1
+			if token == "}":
+				if not closing:
+					raise RpnError("Unbalanced '}'")
+				return pos
+			if token == "if{":
+				pos = self._branch(tokens, pos, stack)
+			elif token == "els{":
+				raise RpnError("'els{' without 'if{'")
+			elif token.startswith("(>"):
+				raise RpnError("Writes are not allowed in value expressions: %s" % (token))
+			elif token.startswith("("):
+				(name, units) = parse_var(token)
+				stack.append("v[%d]" % (self.slot(name, units)))
+			elif token in _BINARY:
+				b = self._pop(stack, token)
+				a = self._pop(stack, token)
+				stack.append(_BINARY[token].format(a, b))
+			elif token in _UNARY:
+				stack.append(_UNARY[token].format(self._pop(stack, token)))
+			elif token == "d":
+				stack.append(self._peek(stack, token))
+			elif token == "p":
+				self._pop(stack, token)
+			elif token == "r":
+				b = self._pop(stack, token)
+				a = self._pop(stack, token)
+				stack.extend([b, a])
+			elif token == "?":
+				c = self._pop(stack, token)
+				b = self._pop(stack, token)
+				a = self._pop(stack, token)
+				stack.append("({0} if {2} != 0 else {1})".format(a, b, c))
+			elif re.match(r"^s\d+$", token):
+				self.registers[token[1:]] = self._peek(stack, token)
+			elif re.match(r"^l\d+$", token):
+				stack.append(self.registers.get(token[1:], "0.0"))
+			else:
+				try:
+					number = float(token)
+				except ValueError:
+					number = None
+				# nan, inf and 1e999 would repr to bare names, not literals.
+				if number is None or not math.isfinite(number):
+					raise RpnError("Unknown token: %s" % (token))
+				stack.append(repr(number))
+		if closing:
+			raise RpnError("Missing '}'")
+		return pos
+
+	def _branch(self, tokens, pos, stack):
+		# Each branch runs on its own copy of the stack and the registers;
+		# whatever differs afterwards becomes a conditional expression.
+		cond = self._pop(stack, "if{")
+		registers = self.registers
+		then = list(stack)
+		self.registers = dict(registers)
+		pos = self.run(tokens, pos, then, closing=True)
+		then_registers = self.registers
+		other = list(stack)
+		self.registers = dict(registers)
+		if pos < len(tokens) and tokens[pos] == "els{":
+			pos = self.run(tokens, pos + 1, other, closing=True)
+		other_registers = self.registers
+		if len(then) != len(other):
+			raise RpnError("Branches of if{ leave different stack depths")
+		stack[:] = [self._select(cond, a, b) for a, b in zip(then, other)]
+		self.registers = {
+			name: self._select(cond, then_registers.get(name, "0.0"), other_registers.get(name, "0.0"))
+			for name in set(then_registers) | set(other_registers)
+		}
+		return pos
+
+	def _select(self, cond, a, b):
+		if a == b:
+			return a
+		return "({0} if {1} != 0 else {2})".format(a, cond, b)
+
+	def _pop(self, stack, token):
+		if not stack:
+			raise RpnError("Stack underflow at '%s'" % (token))
+		return stack.pop()
+
+	def _peek(self, stack, token):
+		if not stack:
+			raise RpnError("Stack underflow at '%s'" % (token))
+		return stack[-1]
+
+
+class RpnExpression(object):
+	"""One compiled expression: fn(v) evaluates it against the slot list v."""
+
+	def __init__(self, name, source, fn, slots):
+		self.name = name
+		self.source = source
+		self.fn = fn
+		self.slots = slots
+		self.value = None
+
+
+class RpnEngine(object):
+	"""Compiled expressions over a shared set of variables.
+
+	Every variable gets a slot in one value list. update() copies the
+	latest values out of the store, and only the expressions that read a
+	slot whose value changed are re-evaluated (var -> expressions index),
+	so a frame where nothing moved costs one lookup per variable.
+	"""
+
+	def __init__(self, _store=None):
+		self.store = _store
+		self.vars = []
+		self.units = []
+		self.index = {}
+		self.values = []
+		self.dependents = []
+		self.expressions = {}
+		self._dirty = set()
+
+	def slot(self, name, units=None):
+		i = self.index.get(name)
+		if i is None:
+			i = len(self.vars)
+			self.index[name] = i
+			self.vars.append(name)
+			self.units.append(units)
+			self.values.append(0.0)
+			self.dependents.append([])
+		elif self.units[i] is None and units:
+			self.units[i] = units
+		return i
+
+	def compile(self, source):
+		# Returns (function, slots) for one RPN expression.
+		used = []
+
+		def slot(name, units):
+			i = self.slot(name, units)
+			if i not in used:
+				used.append(i)
+			return i
+
+		stack = []
+		_Compiler(slot).run(_TOKEN.findall(source), 0, stack)
+		if not stack:
+			raise RpnError("Expression leaves no value: %s" % (source))
+		code = "lambda v: float(%s)" % (stack[-1])
+		return (eval(compile(code, "<rpn>", "eval"), _GLOBALS), used)
+
+	def add(self, name, source):
+		(fn, slots) = self.compile(source)
+		expression = RpnExpression(name, source, fn, slots)
+		self.expressions[name] = expression
+		for i in slots:
+			self.dependents[i].append(expression)
+		self._dirty.add(expression)
+		return expression
+
+	def variables(self):
+		# Store key -> calculator code reading it, ready for
+		# ClientDataChannel.register().
+		return {name: var_expression(name, units) for name, units in zip(self.vars, self.units)}
+
+	def set(self, name, value):
+		# Push one variable value directly, bypassing the store.
+		i = self.index.get(name)
+		if i is None or value is None or value == self.values[i]:
+			return
+		self.values[i] = value
+		self._dirty.update(self.dependents[i])
+
+	def update(self):
+		# Pull every variable from the store, re-evaluate what changed and
+		# return {name: value} for the expressions whose result changed.
+		if self.store is not None:
+			values = self.values
+			get = self.store.get
+			for i, name in enumerate(self.vars):
+				value = get(name)
+				if value is not None and value != values[i]:
+					values[i] = value
+					self._dirty.update(self.dependents[i])
+		return self.evaluate()
+
+	def evaluate(self):
+		changed = {}
+		values = self.values
+		for expression in self._dirty:
+			# One bad expression must not stop the others from updating.
+			try:
+				value = expression.fn(values)
+			except Exception:
+				value = None
+			if value != expression.value:
+				expression.value = value
+				changed[expression.name] = value
+		self._dirty.clear()
+		return changed
+
+	def get(self, name, default=None):
+		expression = self.expressions.get(name)
+		if expression is None:
+			return default
+		return expression.value
+
+
+def load_mfproj(path):
+	# Active MobiFlight outputs with a SimConnect RPN source:
+	# [{"name", "guid", "device", "pin", "expression", "modifiers"}].
+	with open(path, encoding="utf-8") as fp:
+		project = json.load(fp)
+	outputs = []
+	for config in project.get("ConfigFiles", []):
+		for item in config.get("ConfigItems", []):
+			if item.get("Type") != "OutputConfigItem" or not item.get("Active", True):
+				continue
+			source = (item.get("Source") or {}).get("SimConnectValue")
+			if not source or not source.get("Value"):
+				continue
+			device = item.get("Device") or {}
+			outputs.append({
+				"name": item.get("Name"),
+				"guid": item.get("GUID"),
+				"device": item.get("DeviceName"),
+				"pin": device.get("Pin"),
+				"expression": source["Value"],
+				"modifiers": (item.get("Modifiers") or {}).get("Items", []),
+			})
+	return outputs
+
+
+def engine_from_mfproj(path, _store=None):
+	# Compile every output of a .mfproj into one engine keyed by GUID.
+	engine = RpnEngine(_store)
+	for output in load_mfproj(path):
+		engine.add(output["guid"] or output["name"], output["expression"])
+	return engine
@@ -0,0 +1,25 @@
+class SendLog(object):
+	"""Bounded map from SimConnect send IDs to the object that sent them.
+
+	Send IDs come from GetLastSentPacketID and grow monotonically, so a
+	fixed ring indexed by sendID % capacity keeps the most recent sends
+	without any eviction bookkeeping. Each entry holds the owner (a Request,
+	DefinitionGroup, event name...) and, for definitions, the datum key that
+	the packet added, so an exception resolves in O(1).
+	"""
+
+	def __init__(self, capacity=4096):
+		self.capacity = capacity
+		self.slots = [None] * capacity
+
+	def record(self, sendID, owner, datum=None):
+		self.slots[sendID % self.capacity] = (sendID, owner, datum)
+
+	def lookup(self, sendID):
+		entry = self.slots[sendID % self.capacity]
+		if entry is None or entry[0] != sendID:
+			return None
+		return (entry[1], entry[2])
+
+	def clear(self):
+		self.slots = [None] * self.capacity
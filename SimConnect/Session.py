@@ -0,0 +1,79 @@
+from .Enum import *
+from .Constants import *
+
+
+class Session(object):
+	"""What the client has told the sim, kept across connections.
+
+	Owners stay in sm.Requests and event mappings in sm.events when the
+	connection drops, with the IDs they were given. After the next Open,
+	replay() re-issues every mapping, notification group membership and
+	priority, definition and subscription in one pass before the dispatch
+	thread starts, so the handles consumers hold (Request, DefinitionGroup,
+	Event) keep working and pushed data resumes with the first frames
+	after SIMCONNECT_RECV_ID_OPEN.
+
+	An owner that needs more than its definition back implements replay();
+	anything else gets _deff_test().
+	"""
+
+	def __init__(self, _sm):
+		self.sm = _sm
+		# (group, event, maskable) in the order they were added.
+		self.notifications = []
+		# group -> priority
+		self.priorities = {}
+		self.replays = 0
+
+	def add_notification(self, group, evnt, bMaskable):
+		entry = (int(group), int(evnt), bool(bMaskable))
+		if entry not in self.notifications:
+			self.notifications.append(entry)
+
+	def owners(self):
+		# Every registered owner once, even if it holds several request IDs.
+		seen = {}
+		for owner in list(self.sm.Requests.values()):
+			seen.setdefault(id(owner), owner)
+		return list(seen.values())
+
+	def reset(self):
+		# The new connection knows none of our definitions, and values
+		# from the previous one are stale.
+		for owner in self.owners():
+			owner.defined = False
+			if hasattr(owner, "outData"):
+				owner.outData = None
+			if hasattr(owner, "LastData"):
+				# Otherwise a read within the cache age returns the None above.
+				owner.LastData = 0
+		for attr in ("DEFINITION_POS", "DEFINITION_WAYPOINT"):
+			ID = getattr(self.sm, attr)
+			if ID is not None:
+				self.sm.def_ids.release(ID)
+				setattr(self.sm, attr, None)
+
+	def replay(self):
+		sm = self.sm
+		for name, evnt in list(sm.events.items()):
+			err = sm.dll.MapClientEventToSimEvent(sm.hSimConnect, evnt.value, name)
+			sm.track(name)
+			if not sm.IsHR(err, 0):
+				LOGGER.error("Replay MapToSimEvent " + str(name))
+		for (group, evnt, maskable) in self.notifications:
+			sm.dll.AddClientEventToNotificationGroup(sm.hSimConnect, group, evnt, maskable)
+		for group, priority in self.priorities.items():
+			sm.dll.SetNotificationGroupPriority(sm.hSimConnect, group, priority)
+
+		owners = self.owners()
+		for owner in owners:
+			try:
+				replay = getattr(owner, "replay", None)
+				if replay is not None:
+					replay()
+				else:
+					owner._deff_test()
+			except OSError as err:
+				LOGGER.error("Replay failed for %s: %s" % (owner, err))
+		self.replays += 1
+		LOGGER.debug("Replayed %d events, %d owners." % (len(sm.events), len(owners)))
@@ -5,13 +5,26 @@ import time
 from .Enum import *
 from .Constants import *
 from .Attributes import *
+from .Backend import load_backend
+from .DataStore import DataStore
+from .Dispatch import DispatchEngine, ThreadEventWait
+from .Ring import default_ring
+from .Session import Session
+from .IdAllocator import IdAllocator
+from .Completion import Completion, wait_all
+from .DataLayout import DATA_OFFSET
+from .SendLog import SendLog
+import struct
 import os
 import threading
+from concurrent.futures import Future, TimeoutError as FutureTimeoutError
 
 _library_path = os.path.splitext(os.path.abspath(__file__))[0] + '.dll'
 
 LOGGER = logging.getLogger(__name__)
 
+_FLOAT64 = struct.Struct('<d')
+
 
 def millis():
 	return int(round(time.time() * 1000))
@@ -20,11 +33,21 @@ def millis():
 class SimConnect:
 
 	def IsHR(self, hr, value):
-		_hr = ctypes.HRESULT(hr)
-		return ctypes.c_ulong(_hr.value).value == value
+		# HRESULTs are 32-bit; compare them unsigned on every platform.
+		return ctypes.c_uint32(hr).value == value
 
 	def handle_id_event(self, event):
+		# Client events in a listener's notification group go to its
+		# callbacks; everything else is a system event.
+		listener = self.listeners.get(event.uGroupID)
+		if listener is not None:
+			listener.dispatch(event)
+			return
 		uEventID = event.uEventID
+		handler = self.system_events.get(uEventID)
+		if handler is not None:
+			handler.on_event(event)
+			return
 		if uEventID == self.dll.EventID.EVENT_SIM_START:
 			LOGGER.info("SIM START")
 			self.running = True
@@ -43,34 +66,50 @@ class SimConnect:
 		dwRequestID = ObjData.dwRequestID
 		if dwRequestID in self.Requests:
 			_request = self.Requests[dwRequestID]
-			rtype = _request.definitions[0][1].decode()
-			if 'string' in rtype.lower():
-				pS = cast(ObjData.dwData, c_char_p)
-				_request.outData = pS.value
+			if hasattr(_request, "decode"):
+				_request.decode(ObjData)
 			else:
-				_request.outData = cast(
-					ObjData.dwData, POINTER(c_double * len(_request.definitions))
-				).contents[0]
+				rtype = _request.definitions[0][1].decode()
+				if 'string' in rtype.lower():
+					pS = cast(ObjData.dwData, c_char_p)
+					_request.outData = pS.value
+				else:
+					_request.outData = _FLOAT64.unpack_from(ObjData, DATA_OFFSET)[0]
+			completion = self.Completions.get(dwRequestID)
+			if completion is not None:
+				completion.set()
 		else:
 			LOGGER.warn("Event ID: %d Not Handled." % (dwRequestID))
 
 	def handle_exception_event(self, exc):
-		_exception = SIMCONNECT_EXCEPTION(exc.dwException).name
-		_unsendid = exc.UNKNOWN_SENDID
+		_exception = SIMCONNECT_EXCEPTION(exc.dwException)
 		_sendid = exc.dwSendID
-		_unindex = exc.UNKNOWN_INDEX
 		_index = exc.dwIndex
+		self.exceptions[_exception.name] = self.exceptions.get(_exception.name, 0) + 1
+
+		sent = self.sent.lookup(_sendid)
+		if sent is None:
+			LOGGER.warning("%s: send ID %d, parameter %d" % (_exception.name, _sendid, _index))
+			return
+		(owner, datum) = sent
+		if hasattr(owner, "on_exception"):
+			owner.on_exception(_exception, datum)
+		else:
+			LOGGER.warning("%s: in %s" % (_exception.name, owner))
 
-		# request exceptions
-		for _reqin in self.Requests:
-			_request = self.Requests[_reqin]
-			if _request.LastID == _unsendid:
-				LOGGER.warn("%s: in %s" % (_exception, _request.definitions[0]))
-				return
-
-		LOGGER.warn(_exception)
+	def track(self, owner, datum=None):
+		# Remember who sent the last packet so its exception can be routed
+		# back without a scan; returns the send ID.
+		temp = DWORD(0)
+		self.dll.GetLastSentPacketID(self.hSimConnect, temp)
+		self.sent.record(temp.value, owner, datum)
+		return temp.value
 
 	def handle_state_event(self, pData):
+		owner = self.Requests.get(pData.dwRequestID)
+		if owner is not None and hasattr(owner, "on_state"):
+			owner.on_state(pData)
+			return
 		print("I:", pData.dwInteger, "F:", pData.fFloat, "S:", pData.szString)
 
 	# TODO: update callbackfunction to expand functions.
@@ -81,6 +120,10 @@ class SimConnect:
 			evt = cast(pData, POINTER(SIMCONNECT_RECV_EVENT)).contents
 			self.handle_id_event(evt)
 
+		elif dwID == SIMCONNECT_RECV_ID.SIMCONNECT_RECV_ID_EVENT_FILENAME:
+			evt = cast(pData, POINTER(SIMCONNECT_RECV_EVENT_FILENAME)).contents
+			self.handle_id_event(evt)
+
 		elif dwID == SIMCONNECT_RECV_ID.SIMCONNECT_RECV_ID_SYSTEM_STATE:
 			state = cast(pData, POINTER(SIMCONNECT_RECV_SYSTEM_STATE)).contents
 			self.handle_state_event(state)
@@ -91,9 +134,23 @@ class SimConnect:
 			).contents
 			self.handle_simobject_event(pObjData)
 
+		elif dwID == SIMCONNECT_RECV_ID.SIMCONNECT_RECV_ID_SIMOBJECT_DATA:
+			pObjData = cast(
+				pData, POINTER(SIMCONNECT_RECV_SIMOBJECT_DATA)
+			).contents
+			self.handle_simobject_event(pObjData)
+
+		elif dwID == SIMCONNECT_RECV_ID.SIMCONNECT_RECV_ID_CLIENT_DATA:
+			pObjData = cast(
+				pData, POINTER(SIMCONNECT_RECV_CLIENT_DATA)
+			).contents
+			self.handle_simobject_event(pObjData)
+
 		elif dwID == SIMCONNECT_RECV_ID.SIMCONNECT_RECV_ID_OPEN:
 			LOGGER.info("SIM OPEN")
 			self.ok = True
+			if not self.opened.done():
+				self.opened.set_result(self)
 
 		elif dwID == SIMCONNECT_RECV_ID.SIMCONNECT_RECV_ID_EXCEPTION:
 			exc = cast(pData, POINTER(SIMCONNECT_RECV_EXCEPTION)).contents
@@ -125,29 +182,80 @@ class SimConnect:
 			LOGGER.debug("Received:", SIMCONNECT_RECV_ID(dwID))
 		return
 
-	def __init__(self, auto_connect=True, library_path=_library_path):
+	def __init__(self, auto_connect=True, library_path=_library_path, wait_strategy=None, timeout=10, backend=None):
 
 		self.Requests = {}
+		self.Completions = {}
 		self.Facilities = []
-		self.dll = SimConnectDll(library_path)
+		self.store = DataStore()
+		self.dll = load_backend(library_path, backend)
+		self.def_ids = IdAllocator(len(self.dll.DATA_DEFINITION_ID), "Definition")
+		self.request_ids = IdAllocator(len(self.dll.DATA_REQUEST_ID), "Request")
+		self.event_ids = IdAllocator(len(self.dll.EventID), "Event")
+		self.client_data_ids = IdAllocator(len(self.dll.CLIENT_DATA_ID), "ClientData")
+		self.client_def_ids = IdAllocator(len(self.dll.CLIENT_DATA_DEFINITION_ID), "ClientDefinition")
+		self.group_ids = IdAllocator(len(self.dll.GROUP_ID), "Group")
+		self.events = {}
+		# Notification group ID -> EventListener.
+		self.listeners = {}
+		# System event ID -> owner with on_event(), e.g. SimStateTracker.
+		self.system_events = {}
+		self.session = Session(self)
+		# Exceptions are routed through the send log; a datum that raises
+		# exception_limit of them is disabled by its owner.
+		self.sent = SendLog()
+		self.exceptions = {}
+		self.exception_limit = 3
 		self.hSimConnect = HANDLE()
 		self.quit = 0
 		self.ok = False
+		self.opened = Future()
+		self.closed = threading.Event()
+		self.timerThread = None
+		self.handle_open = False
+		self._exit_lock = threading.Lock()
 		self.running = False
 		self.paused = False
 		self.DEFINITION_POS = None
 		self.DEFINITION_WAYPOINT = None
 		self.my_dispatch_proc_rd = self.dll.DispatchProc(self.my_dispatch_proc)
+		if wait_strategy is None and getattr(self.dll, "in_process", False):
+			wait_strategy = ThreadEventWait()
+		self.dispatcher = DispatchEngine(self, wait_strategy, default_ring(self.dll))
 		if auto_connect:
-			self.connect()
+			self.connect(timeout)
 
-	def connect(self):
+	def connect(self, timeout=10):
+		# Block until SIMCONNECT_RECV_ID_OPEN arrives, at most timeout seconds.
+		opened = self.connect_async()
 		try:
+			opened.result(timeout)
+		except FutureTimeoutError:
+			LOGGER.debug("No SIMCONNECT_RECV_ID_OPEN within %ss." % (timeout))
+			self.exit()
+			raise ConnectionError("Flight Simulator did not answer the handshake.")
+
+	def connect_async(self, callback=None):
+		# Open the connection and return a Future resolved with self once the
+		# sim acknowledges it. callback(future) runs on completion.
+		self.quit = 0
+		self.ok = False
+		self.opened = Future()
+		self.closed.clear()
+		# Owners and event mappings keep their IDs; the session defines
+		# them again on the new connection.
+		self.sent.clear()
+		self.session.reset()
+		if callback is not None:
+			self.opened.add_done_callback(callback)
+		try:
+			self.dispatcher.wait.open()
 			err = self.dll.Open(
-				byref(self.hSimConnect), LPCSTR(b"Request Data"), None, 0, 0, 0
+				byref(self.hSimConnect), LPCSTR(b"Request Data"), None, 0, self.dispatcher.wait.handle, 0
 			)
 			if self.IsHR(err, 0):
 				LOGGER.debug("Connected to Flight Simulator!")
+				self.handle_open = True
 				# Request an event when the simulation starts
 
 				# The user is in control of the aircraft
@@ -166,41 +274,55 @@ class SimConnect:
 				self.dll.SubscribeToSystemEvent(
 					self.hSimConnect, self.dll.EventID.EVENT_SIM_UNPAUSED, b"Unpaused"
 				)
+				self.session.replay()
 				self.timerThread = threading.Thread(target=self._run)
 				self.timerThread.daemon = True
 				self.timerThread.start()
-				while self.ok is False:
-					pass
+			else:
+				raise OSError("SimConnect_Open failed")
 		except OSError:
 			LOGGER.debug("Did not find Flight Simulator running.")
+			self.closed.set()
+			self.opened.set_exception(ConnectionError("Did not find Flight Simulator running."))
 			raise ConnectionError("Did not find Flight Simulator running.")
+		return self.opened
 
 	def _run(self):
-		while self.quit == 0:
-			try:
-				self.dll.CallDispatch(self.hSimConnect, self.my_dispatch_proc_rd, None)
-				time.sleep(.002)
-			except OSError as err:
-        			print("OS error: {0}".format(err))
+		try:
+			self.dispatcher.run()
+		finally:
+			self.ok = False
+			if not self.opened.done():
+				self.opened.set_exception(ConnectionError("Connection closed before open."))
+			self.closed.set()
 
 	def exit(self):
-		self.quit = 1
-		self.timerThread.join()
-		self.dll.Close(self.hSimConnect)
+		with self._exit_lock:
+			self.quit = 1
+			self.dispatcher.stop()
+			if self.timerThread is not None and self.timerThread is not threading.current_thread():
+				self.timerThread.join()
+			self.timerThread = None
+			if self.handle_open:
+				self.handle_open = False
+				self.dll.Close(self.hSimConnect)
+			# The connection no longer signals the event; a reconnect opens
+			# a new one.
+			self.dispatcher.wait.close()
 
 	def map_to_sim_event(self, name):
-		for m in self.dll.EventID:
-			if name.decode() == m.name:
-				LOGGER.debug("Already have event: ", m)
-				return m
-
-		names = [m.name for m in self.dll.EventID] + [name.decode()]
-		self.dll.EventID = Enum(self.dll.EventID.__name__, names)
-		evnt = list(self.dll.EventID)[-1]
+		evnt = self.events.get(name)
+		if evnt is not None:
+			return evnt
+
+		evnt = self.event_ids.acquire(name.decode())
 		err = self.dll.MapClientEventToSimEvent(self.hSimConnect, evnt.value, name)
+		self.track(name)
 		if self.IsHR(err, 0):
+			self.events[name] = evnt
 			return evnt
 		else:
+			self.event_ids.release(evnt)
 			LOGGER.error("Error: MapToSimEvent")
 			return None
 
@@ -208,9 +330,24 @@ class SimConnect:
 		self.dll.AddClientEventToNotificationGroup(
 			self.hSimConnect, group, evnt, bMaskable
 		)
+		self.session.add_notification(group, evnt, bMaskable)
+
+	def set_notification_group_priority(self, group, priority=SIMCONNECT_GROUP_PRIORITY_HIGHEST):
+		# A group only receives events once it has a priority.
+		self.dll.SetNotificationGroupPriority(self.hSimConnect, group, priority)
+		self.session.priorities[int(group)] = priority
+
+	def completion(self, REQUEST_ID):
+		completion = self.Completions.get(REQUEST_ID.value)
+		if completion is None:
+			completion = Completion()
+			self.Completions[REQUEST_ID.value] = completion
+		return completion
 
 	def request_data(self, _Request):
 		_Request.outData = None
+		completion = self.completion(_Request.DATA_REQUEST_ID)
+		completion.arm()
 		self.dll.RequestDataOnSimObjectType(
 			self.hSimConnect,
 			_Request.DATA_REQUEST_ID.value,
@@ -218,9 +355,8 @@ class SimConnect:
 			0,
 			SIMCONNECT_SIMOBJECT_TYPE.SIMCONNECT_SIMOBJECT_TYPE_USER,
 		)
-		temp = DWORD(0)
-		self.dll.GetLastSentPacketID(self.hSimConnect, temp)
-		_Request.LastID = temp.value
+		_Request.LastID = self.track(_Request)
+		return completion
 
 	def set_data(self, _Request):
 		rtype = _Request.definitions[0][1].decode()
@@ -243,6 +379,7 @@ class SimConnect:
 			sizeof(ctypes.c_double) * len(pyarr),
 			pObjData
 		)
+		self.track(_Request)
 		if self.IsHR(err, 0):
 			# LOGGER.debug("Request Sent")
 			return True
@@ -250,18 +387,24 @@ class SimConnect:
 			return False
 
 	def get_data(self, _Request):
-		self.request_data(_Request)
-		# self.run()
-		attemps = 0
-		while _Request.outData is None and attemps < _Request.attemps:
-			# self.run()
-			time.sleep(.01)
-			attemps += 1
+		# Wait at most the old polling budget (attemps x 10 ms), but wake
+		# the moment the dispatch thread delivers the data.
+		completion = self.request_data(_Request)
+		completion.wait(_Request.attemps * .01)
 		if _Request.outData is None:
 			return False
 
 		return True
 
+	def get_many(self, _Requests, timeout=None):
+		# Issue every request first, then wait for all of them together.
+		_Requests = list(_Requests)
+		completions = [self.request_data(_Request) for _Request in _Requests]
+		if timeout is None:
+			timeout = max([_Request.attemps for _Request in _Requests] + [0]) * .01
+		wait_all(completions, timeout)
+		return [_Request.outData is not None for _Request in _Requests]
+
 	def send_event(self, evnt, data=DWORD(0)):
 		err = self.dll.TransmitClientEvent(
 			self.hSimConnect,
@@ -271,6 +414,7 @@ class SimConnect:
 			SIMCONNECT_GROUP_PRIORITY_HIGHEST,
 			DWORD(16),
 		)
+		self.track(evnt.name)
 
 		if self.IsHR(err, 0):
 			# LOGGER.debug("Event Sent")
@@ -279,20 +423,19 @@ class SimConnect:
 			return False
 
 	def new_def_id(self):
-		_name = "Definition" + str(len(list(self.dll.DATA_DEFINITION_ID)))
-		names = [m.name for m in self.dll.DATA_DEFINITION_ID] + [_name]
-
-		self.dll.DATA_DEFINITION_ID = Enum(self.dll.DATA_DEFINITION_ID.__name__, names)
-		DEFINITION_ID = list(self.dll.DATA_DEFINITION_ID)[-1]
-		return DEFINITION_ID
+		return self.def_ids.acquire()
 
 	def new_request_id(self):
-		name = "Request" + str(len(self.dll.DATA_REQUEST_ID))
-		names = [m.name for m in self.dll.DATA_REQUEST_ID] + [name]
-		self.dll.DATA_REQUEST_ID = Enum(self.dll.DATA_REQUEST_ID.__name__, names)
-		REQUEST_ID = list(self.dll.DATA_REQUEST_ID)[-1]
+		return self.request_ids.acquire()
+
+	def release_def_id(self, DEFINITION_ID):
+		self.dll.ClearDataDefinition(self.hSimConnect, DEFINITION_ID.value)
+		self.def_ids.release(DEFINITION_ID)
 
-		return REQUEST_ID
+	def release_request_id(self, REQUEST_ID):
+		self.Requests.pop(REQUEST_ID.value, None)
+		self.Completions.pop(REQUEST_ID.value, None)
+		self.request_ids.release(REQUEST_ID)
 
 	def add_waypoints(self, _waypointlist):
 		if self.DEFINITION_WAYPOINT is None:
@@ -0,0 +1,179 @@
+import threading
+from .Enum import *
+from .Constants import *
+
+
+DISCONNECTED = "disconnected"
+MENU = "menu"
+FLYING = "flying"
+PAUSED = "paused"
+CRASHED = "crashed"
+
+# dwData flags of the Pause_EX1 system event.
+PAUSE_STATE_FLAG_OFF = 0
+PAUSE_STATE_FLAG_PAUSE = 1
+PAUSE_STATE_FLAG_PAUSE_WITH_SOUND = 2
+PAUSE_STATE_FLAG_ACTIVE_PAUSE = 4
+PAUSE_STATE_FLAG_SIM_PAUSE = 8
+
+
+class SimStateTracker(object):
+	"""Flight, aircraft and pause state, driven by system events.
+
+	Subscribes to Sim, Pause_EX1, FlightLoaded, AircraftLoaded, Crashed
+	and CrashReset, and asks for the current Sim, FlightLoaded and
+	AircraftLoaded state on every connect, since events only report
+	changes. The inputs reduce to one state:
+
+	  disconnected  no connection
+	  crashed       Crashed seen, no CrashReset or new flight since
+	  menu          the sim is not running a flight (Sim = 0)
+	  paused        any Pause_EX1 flag set, active pause included
+	  flying        otherwise; also while Sim has not answered yet
+
+	on_change(callback) calls callback(old, new) on the dispatch thread.
+	The tracker is an owner in sm.Requests, so the session subscribes
+	it again after a reconnect.
+	"""
+
+	EVENTS = ("Sim", "Pause_EX1", "FlightLoaded", "AircraftLoaded", "Crashed", "CrashReset")
+	STATES = ("Sim", "FlightLoaded", "AircraftLoaded")
+
+	def __init__(self, _sm):
+		self.sm = _sm
+		self.defined = False
+		self.events = {}
+		for name in self.EVENTS:
+			evnt = _sm.event_ids.acquire(name)
+			self.events[evnt.value] = name
+			_sm.system_events[evnt.value] = self
+		self.requests = {}
+		for name in self.STATES:
+			rqst = _sm.new_request_id()
+			self.requests[rqst.value] = name
+			_sm.Requests[rqst.value] = self
+		self.listeners = []
+		self._changed = threading.Condition()
+		self._clear()
+		self.state = self._compute()
+		if _sm.handle_open:
+			self._deff_test()
+
+	def _clear(self):
+		self.running = None
+		self.pause_flags = PAUSE_STATE_FLAG_OFF
+		self.crashed = False
+		self.flight = None
+		self.aircraft = None
+
+	@property
+	def active(self):
+		# True while a flight is running and worth sampling.
+		return self.state == FLYING
+
+	def is_flight_loaded(self):
+		return self.flight is not None and self.running is not False
+
+	def on_change(self, callback):
+		self.listeners.append(callback)
+
+	def wait(self, states, timeout=None):
+		# Block until the state is one of states; returns whether it is.
+		if isinstance(states, str):
+			states = (states,)
+		with self._changed:
+			return self._changed.wait_for(lambda: self.state in states, timeout)
+
+	def _compute(self):
+		if not self.sm.ok:
+			return DISCONNECTED
+		if self.crashed:
+			return CRASHED
+		if self.running is False:
+			return MENU
+		if self.pause_flags:
+			return PAUSED
+		return FLYING
+
+	def update(self):
+		# Recompute the state and tell the listeners if it changed.
+		with self._changed:
+			old = self.state
+			self.state = self._compute()
+			if old == self.state:
+				return self.state
+			self._changed.notify_all()
+		LOGGER.info("Sim state: %s -> %s" % (old, self.state))
+		for callback in list(self.listeners):
+			try:
+				callback(old, self.state)
+			except Exception:
+				LOGGER.exception("Sim state callback failed")
+		return self.state
+
+	def on_event(self, event):
+		# SIMCONNECT_RECV_EVENT, or SIMCONNECT_RECV_EVENT_FILENAME for
+		# FlightLoaded and AircraftLoaded.
+		name = self.events.get(event.uEventID)
+		if name == "Sim":
+			self.running = bool(event.dwData)
+		elif name == "Pause_EX1":
+			self.pause_flags = event.dwData
+		elif name == "Crashed":
+			self.crashed = True
+		elif name == "CrashReset":
+			self.crashed = False
+		elif name == "FlightLoaded":
+			self.flight = self._path(getattr(event, "zFileName", b""))
+			self.crashed = False
+		elif name == "AircraftLoaded":
+			self.aircraft = self._path(getattr(event, "zFileName", b""))
+		self.update()
+
+	def on_state(self, pData):
+		# SIMCONNECT_RECV_SYSTEM_STATE answering one of our requests.
+		name = self.requests.get(pData.dwRequestID)
+		if name == "Sim":
+			self.running = bool(pData.dwInteger)
+		elif name == "FlightLoaded":
+			self.flight = self._path(pData.szString)
+		elif name == "AircraftLoaded":
+			self.aircraft = self._path(pData.szString)
+		self.update()
+
+	def _path(self, raw):
+		path = raw.decode(errors="replace")
+		return path or None
+
+	def _deff_test(self):
+		if self.defined:
+			return True
+		for evnt, name in self.events.items():
+			self.sm.dll.SubscribeToSystemEvent(self.sm.hSimConnect, evnt, name.encode())
+			self.sm.track(self, name)
+		for rqst, name in self.requests.items():
+			self.sm.dll.RequestSystemState(self.sm.hSimConnect, rqst, name.encode())
+			self.sm.track(self, name)
+		self.defined = True
+		return True
+
+	def replay(self):
+		# New connection: what we knew is stale until the sim answers.
+		self._clear()
+		return self._deff_test()
+
+	def on_exception(self, exception, datum):
+		LOGGER.warning("%s: in system state %s" % (exception.name, datum))
+
+	def release(self):
+		for evnt in self.events:
+			if self.sm.ok:
+				self.sm.dll.UnsubscribeFromSystemEvent(self.sm.hSimConnect, evnt)
+			self.sm.system_events.pop(evnt, None)
+			self.sm.event_ids.release(evnt)
+		for rqst in self.requests:
+			self.sm.Requests.pop(rqst, None)
+			self.sm.request_ids.release(rqst)
+		self.events = {}
+		self.requests = {}
+		self.defined = False
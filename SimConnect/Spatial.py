@@ -0,0 +1,219 @@
+import heapq
+import math
+from array import array
+from .FacilityStore import AIRPORT, WAYPOINT, NDB, VOR
+
+
+# ----------------------------------------------------------------------------
+#        Spatial index
+#
+# Points are bucketed in cell x cell degree lat/lon cells and kept as unit
+# vectors, so a candidate costs one dot product. Nearest-neighbour search
+# walks rings of cells outwards from the query cell and stops once no
+# unvisited ring can hold anything closer than the current k-th result.
+# ----------------------------------------------------------------------------
+
+EARTH_RADIUS_NM = 3440.065
+
+KINDS = {"airport": AIRPORT, "waypoint": WAYPOINT, "ndb": NDB, "vor": VOR}
+
+
+def _unit(lat, lon):
+	la = math.radians(lat)
+	lo = math.radians(lon)
+	c = math.cos(la)
+	return (c * math.cos(lo), c * math.sin(lo), math.sin(la))
+
+
+def _nm(dot):
+	# Great-circle distance of two unit vectors with dot product dot.
+	return EARTH_RADIUS_NM * math.acos(max(-1.0, min(1.0, dot)))
+
+
+class GridIndex(object):
+	"""Cell buckets over unit-sphere points with k-nearest and radius queries.
+
+	Points are identified by the integer passed to add(), e.g. the row of a
+	FacilityTable, and can be added one at a time as they arrive.
+	"""
+
+	def __init__(self, cell=1.0):
+		self.cell = cell
+		self.lat_cells = int(math.ceil(180.0 / cell))
+		self.lon_cells = int(math.ceil(360.0 / cell))
+		self.cells = {}
+		self.x = array('d')
+		self.y = array('d')
+		self.z = array('d')
+		self.ids = array('l')
+		self.where = []
+
+	def __len__(self):
+		return len(self.ids)
+
+	def _cell(self, lat, lon):
+		i = min(int((lat + 90.0) / self.cell), self.lat_cells - 1)
+		j = int(((lon + 180.0) % 360.0) / self.cell) % self.lon_cells
+		return (i, j)
+
+	def add(self, ident, lat, lon):
+		n = len(self.ids)
+		(x, y, z) = _unit(lat, lon)
+		self.x.append(x)
+		self.y.append(y)
+		self.z.append(z)
+		self.ids.append(ident)
+		key = self._cell(lat, lon)
+		self.where.append(key)
+		self.cells.setdefault(key, []).append(n)
+
+	def move(self, n, lat, lon):
+		# Point n (the n-th add()) now lies at lat/lon.
+		(self.x[n], self.y[n], self.z[n]) = _unit(lat, lon)
+		key = self._cell(lat, lon)
+		old = self.where[n]
+		if key == old:
+			return
+		self.cells[old].remove(n)
+		if not self.cells[old]:
+			del self.cells[old]
+		self.where[n] = key
+		self.cells.setdefault(key, []).append(n)
+
+	def _ring(self, ci, cj, r):
+		# Cells at Chebyshev distance r from (ci, cj); longitude wraps.
+		if r == 0:
+			yield (ci, cj)
+			return
+		span = min(r, self.lon_cells // 2)
+		for i in range(ci - r, ci + r + 1):
+			if i < 0 or i >= self.lat_cells:
+				continue
+			if i in (ci - r, ci + r):
+				cols = range(cj - span, cj + span + 1)
+			elif r <= self.lon_cells // 2:
+				cols = (cj - r, cj + r)
+			else:
+				continue
+			for j in cols:
+				yield (i, j % self.lon_cells)
+
+	def _bound(self, lat, r):
+		# Lower bound in nm on the distance to any cell of ring r + 1.
+		edge = min(90.0, abs(lat) + (r + 1) * self.cell)
+		return r * self.cell * 60.0 * math.cos(math.radians(edge))
+
+	def nearest(self, lat, lon, k=1, limit_nm=None):
+		# [(distance_nm, ident)] of the k nearest points, closest first.
+		if not self.ids or k <= 0:
+			return []
+		(qx, qy, qz) = _unit(lat, lon)
+		(ci, cj) = self._cell(lat, lon)
+		x, y, z, ids, cells = self.x, self.y, self.z, self.ids, self.cells
+		best = []  # min-heap of (dot, n): the k largest dots seen so far
+		seen = set()
+		max_r = max(self.lat_cells, self.lon_cells)
+		for r in range(max_r + 1):
+			for key in self._ring(ci, cj, r):
+				if key in seen:
+					continue
+				seen.add(key)
+				for n in cells.get(key, ()):
+					dot = qx * x[n] + qy * y[n] + qz * z[n]
+					if len(best) < k:
+						heapq.heappush(best, (dot, n))
+					elif dot > best[0][0]:
+						heapq.heapreplace(best, (dot, n))
+			if len(best) == k and _nm(best[0][0]) <= self._bound(lat, r):
+				break
+			if limit_nm is not None and self._bound(lat, r) > limit_nm:
+				break
+		found = [(_nm(dot), ids[n]) for (dot, n) in sorted(best, reverse=True)]
+		if limit_nm is not None:
+			found = [item for item in found if item[0] <= limit_nm]
+		return found
+
+	def within(self, lat, lon, radius_nm):
+		# [(distance_nm, ident)] of every point within radius_nm, closest first.
+		(qx, qy, qz) = _unit(lat, lon)
+		min_dot = math.cos(min(math.pi, radius_nm / EARTH_RADIUS_NM))
+		deg = math.degrees(radius_nm / EARTH_RADIUS_NM)
+		lo_lat = max(-90.0, lat - deg)
+		hi_lat = min(90.0, lat + deg)
+		edge = max(abs(lo_lat), abs(hi_lat))
+		if edge >= 89.999 or deg >= 90.0:
+			lon_span = 180.0
+		else:
+			lon_span = min(180.0, deg / math.cos(math.radians(edge)))
+		(i0, _) = self._cell(lo_lat, lon)
+		(i1, _) = self._cell(hi_lat, lon)
+		cols = min(self.lon_cells, int(math.ceil(lon_span / self.cell)) * 2 + 1)
+		(_, cj) = self._cell(lat, lon - lon_span)
+		x, y, z, ids, cells = self.x, self.y, self.z, self.ids, self.cells
+		found = []
+		for i in range(i0, i1 + 1):
+			for c in range(cols):
+				for n in cells.get((i, (cj + c) % self.lon_cells), ()):
+					dot = qx * x[n] + qy * y[n] + qz * z[n]
+					if dot >= min_dot:
+						found.append((dot, n))
+		found.sort(reverse=True)
+		return [(_nm(dot), ids[n]) for (dot, n) in found]
+
+
+class FacilityIndex(object):
+	"""GridIndex per facility type, kept in step with a FacilityStore.
+
+	The store calls back after every complete list: a replaced table is
+	re-indexed; a SubscribeToFacilities merge moves the rows it overwrote
+	and adds the ones it appended.
+	"""
+
+	def __init__(self, _store, cell=1.0):
+		self.store = _store
+		self.cell = cell
+		self.grids = {}
+		self.tables = {}
+		for kind in KINDS.values():
+			self._rebuild(kind, _store.table(kind))
+		_store.listeners.append(self.update)
+
+	def _rebuild(self, kind, table):
+		# Readers keep using the old grid until the new one is complete.
+		grid = GridIndex(self.cell)
+		self._fill(grid, table, 0)
+		self.tables[kind] = table
+		self.grids[kind] = grid
+
+	def _fill(self, grid, table, start):
+		(lat, lon) = (table.lat, table.lon)
+		for i in range(start, table.rows):
+			grid.add(i, lat[i], lon[i])
+
+	def update(self, kind, table, replaced):
+		# Store listener, called from the dispatch thread.
+		grid = self.grids.get(kind)
+		if replaced or grid is None or table.rows < len(grid):
+			self._rebuild(kind, table)
+		else:
+			# A merge overwrites existing rows in place and appends new ones.
+			self.tables[kind] = table
+			(lat, lon) = (table.lat, table.lon)
+			for i in table.replaced:
+				grid.move(i, lat[i], lon[i])
+			self._fill(grid, table, len(grid))
+
+	def _rows(self, kind, found):
+		table = self.tables[kind]
+		out = []
+		for (distance, i) in found:
+			row = table.row(i)
+			row["distance_nm"] = distance
+			out.append(row)
+		return out
+
+	def nearest(self, lat, lon, kind=AIRPORT, k=1, limit_nm=None):
+		return self._rows(kind, self.grids[kind].nearest(lat, lon, k, limit_nm))
+
+	def within(self, lat, lon, radius_nm, kind=AIRPORT):
+		return self._rows(kind, self.grids[kind].within(lat, lon, radius_nm))
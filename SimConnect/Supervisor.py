@@ -0,0 +1,78 @@
+import threading
+from .Enum import *
+
+
+class ConnectionSupervisor(object):
+	"""Keeps a SimConnect connected from a background thread.
+
+	While the sim is down the thread sleeps between attempts with an
+	exponential backoff; while it is up it blocks on sm.closed, so neither
+	state costs CPU. on_connect(sm) runs after every successful handshake,
+	on_disconnect(sm) after the connection is lost.
+	"""
+
+	def __init__(self, _sm, on_connect=None, on_disconnect=None, timeout=10, min_retry=2, max_retry=30):
+		self.sm = _sm
+		self.on_connect = on_connect
+		self.on_disconnect = on_disconnect
+		self.timeout = timeout
+		self.min_retry = min_retry
+		self.max_retry = max_retry
+		self.retry = min_retry
+		self.attempts = 0
+		self.connected = threading.Event()
+		self._stop = threading.Event()
+		self._thread = None
+
+	def start(self):
+		if self._thread is not None and self._thread.is_alive():
+			return
+		self._stop.clear()
+		self._thread = threading.Thread(target=self._run, name="simconnect-supervisor")
+		self._thread.daemon = True
+		self._thread.start()
+
+	def stop(self):
+		self._stop.set()
+		self.sm.exit()
+		self.sm.closed.set()
+
+	def restart(self):
+		# Drop the current connection; the supervisor reconnects on its own.
+		if self.connected.is_set():
+			self.sm.exit()
+
+	def wait_connected(self, timeout=None):
+		return self.connected.wait(timeout)
+
+	def _connect(self):
+		self.attempts += 1
+		try:
+			self.sm.connect(self.timeout)
+		except ConnectionError:
+			return False
+		return True
+
+	def _run(self):
+		while not self._stop.is_set():
+			if not self._connect():
+				self._stop.wait(self.retry)
+				self.retry = min(self.retry * 2, self.max_retry)
+				continue
+
+			self.retry = self.min_retry
+			self.connected.set()
+			if self.on_connect is not None:
+				try:
+					self.on_connect(self.sm)
+				except Exception as err:
+					LOGGER.error("on_connect failed: {0}".format(err))
+
+			self.sm.closed.wait()
+			self.connected.clear()
+			self.sm.exit()
+			if self.on_disconnect is not None:
+				try:
+					self.on_disconnect(self.sm)
+				except Exception as err:
+					LOGGER.error("on_disconnect failed: {0}".format(err))
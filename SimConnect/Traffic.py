@@ -0,0 +1,191 @@
+import threading
+from SimConnect import *
+from array import array
+from .Enum import *
+from .Constants import *
+from .DataLayout import DataLayout, DATA_OFFSET
+
+
+class TrafficTable(object):
+	"""Columnar snapshot of every aircraft returned by one traffic request.
+
+	Row i of every column describes the same object. Columns are typed
+	arrays sized once per cycle, so a table of several hundred aircraft is
+	a handful of allocations rather than one object per aircraft.
+	"""
+
+	columns = ("lat", "lon", "alt", "hdg", "gs")
+
+	def __init__(self, size=0, timestamp=0):
+		self.size = size
+		self.timestamp = timestamp
+		self.ids = array('I', [0]) * size
+		self.lat = array('d', [0.0]) * size
+		self.lon = array('d', [0.0]) * size
+		self.alt = array('d', [0.0]) * size
+		self.hdg = array('d', [0.0]) * size
+		self.gs = array('d', [0.0]) * size
+		self.filled = 0
+
+	def __len__(self):
+		return self.size
+
+	def row(self, i):
+		return {
+			"id": self.ids[i],
+			"lat": self.lat[i],
+			"lon": self.lon[i],
+			"alt": self.alt[i],
+			"hdg": self.hdg[i],
+			"gs": self.gs[i],
+		}
+
+	def json(self):
+		return [self.row(i) for i in range(self.size)]
+
+
+class TrafficReader(object):
+	"""Periodic radius query for AI and multiplayer aircraft around the user.
+
+	Each refresh issues one RequestDataOnSimObjectType for
+	SIMCONNECT_SIMOBJECT_TYPE_AIRCRAFT; the sim answers with one message per
+	object (dwentrynumber of dwoutof), which decode() writes straight into
+	the pending table's columns. Once every entry has arrived the table
+	replaces self.table and `updated` is set.
+	"""
+
+	# Radius is capped by SimConnect at 200 km.
+	MAX_RADIUS = 200000
+
+	definitions = [
+		(b'PLANE LATITUDE', b'Degrees'),
+		(b'PLANE LONGITUDE', b'Degrees'),
+		(b'PLANE ALTITUDE', b'Feet'),
+		(b'PLANE HEADING DEGREES TRUE', b'Degrees'),
+		(b'GROUND VELOCITY', b'Knots'),
+	]
+
+	def __init__(self, _sm, radius=50000, interval=1.0, _type=SIMCONNECT_SIMOBJECT_TYPE.SIMCONNECT_SIMOBJECT_TYPE_AIRCRAFT):
+		self.sm = _sm
+		self.radius = min(int(radius), self.MAX_RADIUS)
+		self.interval = interval
+		self.type = _type
+		self.DATA_DEFINITION_ID = None
+		self.DATA_REQUEST_ID = None
+		self.defined = False
+		self.table = TrafficTable()
+		self.pending = None
+		self.updated = threading.Event()
+		self.cycles = 0
+		self._layout = DataLayout([SIMCONNECT_DATATYPE.SIMCONNECT_DATATYPE_FLOAT64] * len(self.definitions))
+		self._stop = threading.Event()
+		self._thread = None
+
+	def _deff_test(self):
+		if self.defined is True:
+			return True
+		if self.DATA_DEFINITION_ID is None:
+			self.DATA_DEFINITION_ID = self.sm.new_def_id()
+			self.DATA_REQUEST_ID = self.sm.new_request_id()
+			self.sm.Requests[self.DATA_REQUEST_ID.value] = self
+
+		for (datum, units) in self.definitions:
+			err = self.sm.dll.AddToDataDefinition(
+				self.sm.hSimConnect,
+				self.DATA_DEFINITION_ID.value,
+				datum,
+				units,
+				SIMCONNECT_DATATYPE.SIMCONNECT_DATATYPE_FLOAT64,
+				0,
+				SIMCONNECT_UNUSED,
+			)
+			self.sm.track(self, datum)
+			if not self.sm.IsHR(err, 0):
+				LOGGER.error("SIM def" + str((datum, units)))
+				self.sm.dll.ClearDataDefinition(
+					self.sm.hSimConnect,
+					self.DATA_DEFINITION_ID.value,
+				)
+				return False
+
+		self.defined = True
+		return True
+
+	def refresh(self):
+		# Ask for one new table; returns False if the request was not sent.
+		if not self._deff_test():
+			return False
+		self.updated.clear()
+		err = self.sm.dll.RequestDataOnSimObjectType(
+			self.sm.hSimConnect,
+			self.DATA_REQUEST_ID.value,
+			self.DATA_DEFINITION_ID.value,
+			self.radius,
+			self.type,
+		)
+		self.sm.track(self)
+		return self.sm.IsHR(err, 0)
+
+	def get(self, timeout=1.0):
+		# Refresh and wait for the complete table; falls back to the last one.
+		if self.refresh():
+			self.updated.wait(timeout)
+		return self.table
+
+	def decode(self, ObjData):
+		outof = ObjData.dwoutof
+		entry = ObjData.dwentrynumber
+		if outof == 0:
+			self._publish(TrafficTable(0, millis()))
+			return
+		table = self.pending
+		if entry <= 1 or table is None or table.size != outof:
+			table = self.pending = TrafficTable(outof)
+		i = entry - 1
+		if i < 0 or i >= outof:
+			return
+		(table.lat[i], table.lon[i], table.alt[i], table.hdg[i], table.gs[i]) = self._layout.struct.unpack_from(ObjData, DATA_OFFSET)
+		table.ids[i] = ObjData.dwObjectID
+		table.filled += 1
+		if table.filled == outof:
+			table.timestamp = millis()
+			self.pending = None
+			self._publish(table)
+
+	def _publish(self, table):
+		self.table = table
+		self.cycles += 1
+		self.updated.set()
+
+	def on_exception(self, exception, datum):
+		LOGGER.warning("%s: in traffic %s" % (exception.name, datum))
+
+	def start(self, interval=None):
+		# Refresh every interval seconds from a background thread.
+		if interval is not None:
+			self.interval = interval
+		if self._thread is not None and self._thread.is_alive():
+			return
+		self._stop.clear()
+		self._thread = threading.Thread(target=self._run, name="simconnect-traffic")
+		self._thread.daemon = True
+		self._thread.start()
+
+	def stop(self):
+		self._stop.set()
+
+	def _run(self):
+		while not self._stop.is_set():
+			if self.sm.ok:
+				self.refresh()
+			self._stop.wait(self.interval)
+
+	def release(self):
+		self.stop()
+		if self.DATA_DEFINITION_ID is None:
+			return
+		self.sm.release_def_id(self.DATA_DEFINITION_ID)
+		self.sm.release_request_id(self.DATA_REQUEST_ID)
+		self.DATA_DEFINITION_ID = None
+		self.DATA_REQUEST_ID = None
+		self.defined = False
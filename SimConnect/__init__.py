@@ -1,7 +1,19 @@
 from .SimConnect import SimConnect, millis, DWORD
 from .RequestList import AircraftRequests, Request
+from .DefinitionGroup import DefinitionGroup, WritableGroup, Snapshot
+from .DataStore import DataStore, Frame
+from .Supervisor import ConnectionSupervisor
+from .Traffic import TrafficReader, TrafficTable
+from .ClientData import ClientDataChannel
+from .Rpn import RpnEngine, engine_from_mfproj
+from .FakeSim import FakeSimConnectDll, FlightModel
 from .EventList import AircraftEvents, Event
+from .EventListener import EventListener
+from .SimState import SimStateTracker
 from .FacilitiesList import FacilitiesRequests, Facilitie
+from .FacilityStore import FacilityStore, FacilityTable
+from .Spatial import GridIndex, FacilityIndex
+from .Broker import ConnectionBroker, get_broker
 
 
 def int_or_str(value):
@@ -14,4 +26,4 @@ def int_or_str(value):
 __version__ = "0.4.26"
 VERSION = tuple(map(int_or_str, __version__.split(".")))
 
-__all__ = ["SimConnect", "Request", "Event", "millis", "DWORD", "AircraftRequests", "AircraftEvents", "FacilitiesRequests"]
+__all__ = ["SimConnect", "Request", "Event", "millis", "DWORD", "AircraftRequests", "DefinitionGroup", "WritableGroup", "DataStore", "ConnectionSupervisor", "ConnectionBroker", "get_broker", "TrafficReader", "ClientDataChannel", "RpnEngine", "AircraftEvents", "EventListener", "SimStateTracker", "FacilitiesRequests", "FacilityStore", "FacilityIndex"]
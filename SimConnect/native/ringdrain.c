@@ -0,0 +1,59 @@
+/*
+ * Native drain of the SimConnect dispatch queue into a batch buffer.
+ *
+ * ring_drain() calls SimConnect_GetNextDispatch until the queue is empty,
+ * the record table is full or less than `reserve` bytes are left, copying
+ * every message verbatim to an 8-byte aligned offset of `buffer`. Python
+ * (SimConnect/Ring.py) then walks the batch once per wakeup instead of
+ * crossing ctypes for every message. PyRing in Ring.py produces the same
+ * buffer, offsets and sizes without this library.
+ *
+ * Optional build, next to this file:
+ *   Windows: cl /O2 /LD ringdrain.c /Fe:ringdrain.dll
+ *   Linux:   cc -O2 -shared -fPIC ringdrain.c -o libringdrain.so
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#ifdef _WIN32
+#define RING_EXPORT __declspec(dllexport)
+#define RING_CALL __stdcall
+#else
+#define RING_EXPORT
+#define RING_CALL
+#endif
+
+typedef int32_t (RING_CALL *next_dispatch_fn)(void *handle, void **data, uint32_t *size);
+
+RING_EXPORT uint32_t ring_drain(
+	next_dispatch_fn next,
+	void *handle,
+	uint8_t *buffer,
+	uint32_t capacity,
+	uint32_t reserve,
+	uint32_t *offsets,
+	uint32_t *sizes,
+	uint32_t max_records)
+{
+	uint32_t count = 0;
+	uint32_t pos = 0;
+	void *data;
+	uint32_t size;
+
+	/* Never dequeue a message without room for the largest one. */
+	while (count < max_records && capacity - pos >= reserve) {
+		data = NULL;
+		size = 0;
+		if (next(handle, &data, &size) < 0 || data == NULL)
+			break;
+		if (size > reserve)
+			size = reserve;
+		memcpy(buffer + pos, data, size);
+		offsets[count] = pos;
+		sizes[count] = size;
+		count++;
+		pos += (size + 7u) & ~7u;
+	}
+	return count;
+}
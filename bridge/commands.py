@@ -0,0 +1,214 @@
+import threading
+from collections import OrderedDict
+from dataclasses import dataclass
+from typing import Any
+
+from SimConnect import AircraftEvents, AircraftRequests, WritableGroup
+
+PENDING = "pending"
+WRITTEN = "written"
+SENT = "sent"
+SUPERSEDED = "superseded"
+FAILED = "failed"
+
+
+@dataclass
+class Command:
+    """One backend command and, after flush(), how it was applied.
+
+    simvar/value is tried first; event/event_value is the fallback when the
+    simvar cannot be written, and is sent right away when the catalog marks
+    simvar as not settable. Either may be None. A rejected write turns
+    WRITTEN into SENT or FAILED after flush() has returned.
+    """
+
+    target: str
+    simvar: str | None = None
+    value: float | None = None
+    event: str | None = None
+    event_value: int | None = None
+    status: str = PENDING
+
+
+class CommandQueue:
+    """Collects sim writes and applies them together in flush().
+
+    Commands are keyed by target: a newer command for the same target
+    replaces the queued one, which is reported as superseded. flush()
+    applies the rest in the order their targets were last queued; each
+    run of consecutive simvar writes goes out as one SetDataOnSimObject.
+
+    All simvars ever queued share one WritableGroup; a flush only sends
+    the fields it has values for, as a tagged partial update. A simvar the
+    catalog marks as not settable is skipped when the command has an event
+    to send instead, and written anyway when it has not, as some of those
+    do take writes.
+
+    The sim rejects a write asynchronously, after flush() has reported it
+    as written. The rejected command then falls back to its event from the
+    dispatch thread; when the rejected packet carried several fields, each
+    is sent again on its own first, so one bad field does not sink the
+    others.
+    """
+
+    def __init__(self, aq: AircraftRequests, ae: AircraftEvents):
+        self._aq = aq
+        self._ae = ae
+        self._pending: OrderedDict[str, Command] = OrderedDict()
+        self._superseded: list[Command] = []
+        self._written: dict[str, Command] = {}
+        self._group: WritableGroup | None = None
+        self._unknown: set[str] = set()
+        self._settable: dict[str, bool] = {}
+        self._lock = threading.Lock()
+
+    def __len__(self) -> int:
+        return len(self._pending)
+
+    def put(
+        self,
+        target: str,
+        simvar: str | None = None,
+        value: float | None = None,
+        event: str | None = None,
+        event_value: int | None = None,
+    ) -> Command:
+        command = Command(target, simvar, value, event, event_value)
+        with self._lock:
+            previous = self._pending.pop(target, None)
+            if previous is not None:
+                previous.status = SUPERSEDED
+                self._superseded.append(previous)
+            self._pending[target] = command
+        return command
+
+    def flush(self) -> list[Command]:
+        # Apply everything queued; returns every command since the last
+        # flush, superseded ones included, with its status so far.
+        with self._lock:
+            commands = list(self._pending.values())
+            superseded = self._superseded
+            self._pending = OrderedDict()
+            self._superseded = []
+
+        run: dict[str, Command] = {}
+        for command in commands:
+            if self._writes(command):
+                previous = run.get(command.simvar)
+                if previous is not None:
+                    previous.status = SUPERSEDED
+                run[command.simvar] = command
+                continue
+            self._apply(run)
+            run = {}
+            self._fallback(command)
+        self._apply(run)
+        return superseded + commands
+
+    def _writes(self, command: Command) -> bool:
+        if command.simvar is None or command.value is None:
+            return False
+        if command.event is None:
+            return True
+        settable = self._settable.get(command.simvar)
+        if settable is None:
+            deff = self._aq.definition(command.simvar)
+            settable = self._settable[command.simvar] = deff is None or deff[2]
+        return settable
+
+    def _apply(self, run: dict[str, Command]) -> None:
+        if not run:
+            return
+        self._write(run)
+        for command in run.values():
+            if command.status == PENDING:
+                self._fallback(command)
+
+    def _fallback(self, command: Command) -> None:
+        if command.event is not None and self._send(command.event, command.event_value):
+            command.status = SENT
+        else:
+            command.status = FAILED
+
+    def _write(self, writes: dict[str, Command]) -> bool:
+        group = self._writer(writes)
+        staged = {key: command for (key, command) in writes.items() if group.set(key, float(command.value))}
+        if not staged:
+            return False
+        # Registered before the commit, as a rejection can arrive first.
+        with self._lock:
+            self._written.update(staged)
+        try:
+            ok = group.commit(group.mask(staged), staged)
+        except Exception:
+            ok = False
+        with self._lock:
+            for (key, command) in staged.items():
+                if not ok:
+                    self._forget(key, command)
+                elif command.status == PENDING:
+                    command.status = WRITTEN
+        return ok
+
+    def _forget(self, key: str, command: Command) -> bool:
+        # Called with the lock held; False if a newer write owns key.
+        if self._written.get(key) is not command:
+            return False
+        del self._written[key]
+        return True
+
+    def _rejected(self, exception: Any, commit: Any) -> None:
+        # WritableGroup.on_reject, on the dispatch thread. commit.tag is the
+        # {simvar: Command} that _write() sent.
+        if not commit.tag:
+            return
+        with self._lock:
+            live = {key: command for (key, command) in commit.tag.items() if self._written.get(key) is command}
+        if len(live) > 1:
+            # The exception does not say which field failed.
+            for (key, command) in live.items():
+                if not self._write({key: command}):
+                    with self._lock:
+                        self._forget(key, command)
+                        command.status = FAILED
+                    self._fallback(command)
+            return
+        for (key, command) in live.items():
+            with self._lock:
+                if not self._forget(key, command):
+                    continue
+                # No longer PENDING, so a flush still running leaves it alone.
+                command.status = FAILED
+            self._fallback(command)
+
+    def _writer(self, writes: dict[str, Command]) -> WritableGroup:
+        # Grow the shared group when a new simvar shows up; unknown simvars
+        # are left out and go to their fallback.
+        group = self._group
+        known = set(group.keys + group.disabled) if group is not None else set()
+        fresh = [key for key in writes if key not in known and key not in self._unknown]
+        if group is not None and not fresh:
+            return group
+        for key in fresh:
+            if self._aq.definition(key) is None:
+                self._unknown.add(key)
+        keys = list(group.keys) if group is not None else []
+        keys += [key for key in fresh if key not in self._unknown]
+        if group is not None:
+            group.release()
+        self._group = self._aq.group(keys, _cls=WritableGroup)
+        self._group.on_reject = self._rejected
+        return self._group
+
+    def _send(self, name: str, value: Any) -> bool:
+        event = self._ae.find(name)
+        if event is None:
+            return False
+        try:
+            if value is None:
+                event()
+            else:
+                event(int(value))
+            return True
+        except Exception:
+            return False
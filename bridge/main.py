@@ -2,6 +2,7 @@ import json
 import math
 import os
 import secrets
+import threading
 import time
 import urllib.error
 import urllib.parse
@@ -11,7 +12,10 @@ from datetime import datetime, timezone
 from pathlib import Path
 from typing import Any
 
-from SimConnect import AircraftEvents, AircraftRequests, SimConnect
+from SimConnect import AircraftEvents, AircraftRequests, ConnectionBroker, SimConnect, SimStateTracker, get_broker
+from SimConnect.Broker import Subscription
+from SimConnect.Enum import SIMCONNECT_PERIOD
+from bridge.commands import Command, CommandQueue
 
 
 CONFIG_PATH = Path(__file__).resolve().parent.parent / "bridge-config.json"
@@ -19,6 +23,11 @@ HTTP_TIMEOUT_SECONDS = 10
 LOGIN_POLL_INTERVAL_SECONDS = 10
 TELEMETRY_INTERVAL_SECONDS = 2
 SIMCONNECT_RETRY_SECONDS = 2
+# Upper bound on the sleep while in menus or paused; a state change to
+# flying wakes the loop earlier.
+SIM_IDLE_SECONDS = 30
+SIMCONNECT_MAX_RETRY_SECONDS = 30
+SIMCONNECT_OPEN_TIMEOUT_SECONDS = 10
 
 TRUE_LITERALS = {"1", "true", "yes", "on"}
 FALSE_LITERALS = {"0", "false", "no", "off"}
@@ -29,15 +38,81 @@ ADF_STANDBY_KEYS = {"adf_standby_freq_hz", "adf_standby_frequency_hz", "adf_stan
 FLAPS_KEYS = {"flaps_index", "flaps_handle_index"}
 AUTO_ACK_MASTER_WARN_DEFAULT = -1
 
+TELEMETRY_SIMVARS = (
+    "PLANE_LATITUDE",
+    "PLANE_LONGITUDE",
+    "PLANE_ALTITUDE",
+    "INDICATED_ALTITUDE",
+    "AIRSPEED_INDICATED",
+    "AIRSPEED_TRUE",
+    "GROUND_VELOCITY",
+    "SIM_ON_GROUND",
+    "ENG_COMBUSTION",
+    "GENERAL_ENG_COMBUSTION:1",
+    "TURB_ENG_N1:1",
+    "TURB_ENG_N1:2",
+    "TRANSPONDER_CODE:1",
+    "ADF_ACTIVE_FREQUENCY:1",
+    "ADF_STANDBY_FREQUENCY:1",
+    "VERTICAL_SPEED",
+    "PLANE_PITCH_DEGREES",
+    "GEAR_HANDLE_POSITION",
+    "FLAPS_HANDLE_INDEX",
+    "BRAKE_PARKING_POSITION",
+    "AUTOPILOT_MASTER",
+)
+
+# Mapped as soon as SimConnect connects, not on the first command.
+BRIDGE_EVENTS = (
+    "MASTER_CAUTION_ACKNOWLEDGE",
+    "MASTER_WARNING_ACKNOWLEDGE",
+    "XPNDR_SET",
+    "ADF_COMPLETE_SET",
+    "GEAR_SET",
+    "FLAPS_SET",
+    "AUTOPILOT_ON",
+    "AUTOPILOT_OFF",
+)
+
+# Cockpit key events that change what ATC sees; telemetry goes out as soon
+# as one fires instead of at the next interval.
+ATC_EVENTS = (
+    "XPNDR_SET",
+    "XPNDR_1000_INC",
+    "XPNDR_100_INC",
+    "XPNDR_10_INC",
+    "XPNDR_1_INC",
+    "XPNDR_1000_DEC",
+    "XPNDR_100_DEC",
+    "XPNDR_10_DEC",
+    "XPNDR_1_DEC",
+    "ADF_COMPLETE_SET",
+    "ADF_SET",
+    "ADF_100_INC",
+    "ADF_10_INC",
+    "ADF_1_INC",
+    "ADF_100_DEC",
+    "ADF_10_DEC",
+    "ADF_1_DEC",
+)
+# Wait this long after an event so the sim has applied it and a run of
+# knob clicks goes out as one update.
+EVENT_SETTLE_SECONDS = 0.2
+
 _bridge_token: str | None = None
 _sm: SimConnect | None = None
 _aq: AircraftRequests | None = None
 _ae: AircraftEvents | None = None
+_telemetry: Subscription | None = None
+_state: SimStateTracker | None = None
+_broker: ConnectionBroker | None = None
+_commands: CommandQueue | None = None
 _auto_ack_master_warn: float = AUTO_ACK_MASTER_WARN_DEFAULT
 _master_caution_seen = False
 _master_warning_seen = False
 _master_caution_ack_deadline: float | None = None
 _master_warning_ack_deadline: float | None = None
+_wakeup = threading.Event()
 
 
 def _log_bridge(message: str) -> None:
@@ -172,22 +247,61 @@ def _extract_username(payload: Any) -> str | None:
     return None
 
 
+def _on_simconnect_connected(sm: SimConnect) -> None:
+    _log_bridge(f"simconnect_connected replays={sm.session.replays}")
+
+
+def _on_simconnect_disconnected(sm: SimConnect) -> None:
+    # Handles stay valid across reconnects; sm.ok gates their use meanwhile.
+    _log_bridge("simconnect_disconnected")
+
+
+def _on_cockpit_event(name: str, data: int) -> None:
+    # Dispatch thread: only wake the telemetry loop.
+    _log_bridge(f"cockpit_event name={name} data={data}")
+    _wakeup.set()
+
+
+def _on_sim_state(old: str, new: str) -> None:
+    _log_bridge(f"sim_state old={old} new={new}")
+    if _state is not None and _state.active:
+        _wakeup.set()
+
+
 def _ensure_simconnect() -> bool:
-    global _sm, _aq, _ae
+    global _sm, _aq, _ae, _telemetry, _broker, _commands, _state
 
-    if _sm is not None and _aq is not None and _ae is not None:
-        return True
+    if _broker is None:
+        # Shared with the web server when both run in one process.
+        try:
+            broker = get_broker(
+                timeout=SIMCONNECT_OPEN_TIMEOUT_SECONDS,
+                min_retry=SIMCONNECT_RETRY_SECONDS,
+                max_retry=SIMCONNECT_MAX_RETRY_SECONDS,
+            )
+        except Exception as exc:
+            _log_bridge(f"simconnect_unavailable error={exc}")
+            return False
+        broker.on_connect(_on_simconnect_connected)
+        broker.on_disconnect(_on_simconnect_disconnected)
+        _sm = broker.sm
+        _aq = broker.requests(2000, "bridge")
+        _ae = broker.events(warm=BRIDGE_EVENTS)
+        _commands = CommandQueue(_aq, _ae)
+        _telemetry = broker.subscribe(
+            "bridge",
+            TELEMETRY_SIMVARS,
+            SIMCONNECT_PERIOD.SIMCONNECT_PERIOD_SECOND,
+            changed=True,
+        )
+        listener = broker.listener()
+        for name in ATC_EVENTS:
+            listener.on(name, _on_cockpit_event)
+        _state = broker.state()
+        _state.on_change(_on_sim_state)
+        _broker = broker
 
-    try:
-        _sm = SimConnect()
-        _aq = AircraftRequests(_sm, _time=2000)
-        _ae = AircraftEvents(_sm)
-        return True
-    except Exception:
-        _sm = None
-        _aq = None
-        _ae = None
-        return False
+    return _broker.connected
 
 
 def _to_float(value: Any) -> float | None:
@@ -268,23 +382,6 @@ def _sim_ready_for_commands() -> bool:
     return bool(getattr(_sm, "ok", False))
 
 
-def _force_set_simvar(key: str, value: float) -> bool:
-    if _sm is None or _aq is None:
-        return False
-
-    request = _aq.find(key)
-    if request is None:
-        return False
-
-    try:
-        if not request._deff_test():
-            return False
-        request.outData = value
-        return bool(_sm.set_data(request))
-    except Exception:
-        return False
-
-
 def _send_event(name: str, value: int | None = None) -> bool:
     if _ae is None:
         return False
@@ -437,7 +534,7 @@ def _collect_commands(payload: dict[str, Any]) -> dict[str, Any]:
 
 
 def _build_telemetry_payload(token: str) -> dict[str, Any] | None:
-    if _sm is None or _aq is None:
+    if _sm is None or _aq is None or _telemetry is None:
         _log_bridge("build_telemetry_skip reason=simconnect_objects_missing")
         return None
 
@@ -449,8 +546,13 @@ def _build_telemetry_payload(token: str) -> dict[str, Any] | None:
         )
         return None
 
-    latitude = _to_float(_aq.get("PLANE_LATITUDE"))
-    longitude = _to_float(_aq.get("PLANE_LONGITUDE"))
+    snapshot = _telemetry.latest()
+    if snapshot is None:
+        _log_bridge("build_telemetry_skip reason=snapshot_unavailable")
+        return None
+
+    latitude = _to_float(snapshot.get("PLANE_LATITUDE"))
+    longitude = _to_float(snapshot.get("PLANE_LONGITUDE"))
     if latitude is None or longitude is None:
         _log_bridge(
             f"build_telemetry_skip reason=missing_coordinates lat={latitude} lon={longitude}"
@@ -463,32 +565,32 @@ def _build_telemetry_payload(token: str) -> dict[str, Any] | None:
         )
         return None
 
-    altitude_true = _to_float(_aq.get("PLANE_ALTITUDE")) or 0.0
-    altitude_indicated = _to_float(_aq.get("INDICATED_ALTITUDE")) or 0.0
-    ias = _to_float(_aq.get("AIRSPEED_INDICATED")) or 0.0
-    tas = _to_float(_aq.get("AIRSPEED_TRUE")) or 0.0
-    ground_velocity = _to_float(_aq.get("GROUND_VELOCITY")) or 0.0
-    on_ground = (_to_float(_aq.get("SIM_ON_GROUND")) or 0.0) >= 0.5
+    altitude_true = _to_float(snapshot.get("PLANE_ALTITUDE")) or 0.0
+    altitude_indicated = _to_float(snapshot.get("INDICATED_ALTITUDE")) or 0.0
+    ias = _to_float(snapshot.get("AIRSPEED_INDICATED")) or 0.0
+    tas = _to_float(snapshot.get("AIRSPEED_TRUE")) or 0.0
+    ground_velocity = _to_float(snapshot.get("GROUND_VELOCITY")) or 0.0
+    on_ground = (_to_float(snapshot.get("SIM_ON_GROUND")) or 0.0) >= 0.5
 
-    engine_combustion = _to_float(_aq.get("ENG_COMBUSTION"))
+    engine_combustion = _to_float(snapshot.get("ENG_COMBUSTION"))
     if engine_combustion is None:
-        engine_combustion = _to_float(_aq.get("GENERAL_ENG_COMBUSTION:1")) or 0.0
+        engine_combustion = _to_float(snapshot.get("GENERAL_ENG_COMBUSTION:1")) or 0.0
 
-    n1_1 = _to_float(_aq.get("TURB_ENG_N1:1")) or 0.0
-    n1_2 = _to_float(_aq.get("TURB_ENG_N1:2")) or 0.0
+    n1_1 = _to_float(snapshot.get("TURB_ENG_N1:1")) or 0.0
+    n1_2 = _to_float(snapshot.get("TURB_ENG_N1:2")) or 0.0
 
-    transponder_code = _to_int(_aq.get("TRANSPONDER_CODE:1")) or 0
-    adf_active = _to_int(_aq.get("ADF_ACTIVE_FREQUENCY:1")) or 0
-    adf_standby = _to_float(_aq.get("ADF_STANDBY_FREQUENCY:1")) or 0.0
-    vertical_speed = _to_float(_aq.get("VERTICAL_SPEED")) or 0.0
+    transponder_code = _to_int(snapshot.get("TRANSPONDER_CODE:1")) or 0
+    adf_active = _to_int(snapshot.get("ADF_ACTIVE_FREQUENCY:1")) or 0
+    adf_standby = _to_float(snapshot.get("ADF_STANDBY_FREQUENCY:1")) or 0.0
+    vertical_speed = _to_float(snapshot.get("VERTICAL_SPEED")) or 0.0
 
-    pitch_rad = _to_float(_aq.get("PLANE_PITCH_DEGREES")) or 0.0
+    pitch_rad = _to_float(snapshot.get("PLANE_PITCH_DEGREES")) or 0.0
     pitch_deg = -math.degrees(pitch_rad)
 
-    gear_handle = (_to_float(_aq.get("GEAR_HANDLE_POSITION")) or 0.0) >= 0.5
-    flaps_index = _to_float(_aq.get("FLAPS_HANDLE_INDEX")) or 0.0
-    parking_brake = (_to_float(_aq.get("BRAKE_PARKING_POSITION")) or 0.0) >= 0.5
-    autopilot_master = (_to_float(_aq.get("AUTOPILOT_MASTER")) or 0.0) >= 0.5
+    gear_handle = (_to_float(snapshot.get("GEAR_HANDLE_POSITION")) or 0.0) >= 0.5
+    flaps_index = _to_float(snapshot.get("FLAPS_HANDLE_INDEX")) or 0.0
+    parking_brake = (_to_float(snapshot.get("BRAKE_PARKING_POSITION")) or 0.0) >= 0.5
+    autopilot_master = (_to_float(snapshot.get("AUTOPILOT_MASTER")) or 0.0) >= 0.5
 
     payload: dict[str, Any] = {
         "token": token,
@@ -563,7 +665,7 @@ def register():
 
 
 def send_telemetry() -> int:
-    global _bridge_token, _sm, _aq, _ae
+    global _bridge_token
     _log_bridge("telemetry tick!")
 
     if not _bridge_token:
@@ -579,15 +681,19 @@ def send_telemetry() -> int:
         _log_bridge(f"send_telemetry_skip reason=simconnect_not_ready retry_in_sec={SIMCONNECT_RETRY_SECONDS}")
         return SIMCONNECT_RETRY_SECONDS
 
+    if _state is not None and not _state.active:
+        # Menus, pause or a crash: values are meaningless, skip the upload.
+        _log_bridge(f"send_telemetry_skip reason=sim_{_state.state} retry_in_sec={SIM_IDLE_SECONDS}")
+        return SIM_IDLE_SECONDS
+
     # _tick_auto_ack_master_warn()
 
     try:
         payload = _build_telemetry_payload(token)
         _log_bridge(payload)
     except Exception:
-        _sm = None
-        _aq = None
-        _ae = None
+        if _broker is not None:
+            _broker.supervisor.restart()
         _log_bridge(f"send_telemetry_error reason=payload_build_failed retry_in_sec={SIMCONNECT_RETRY_SECONDS}")
         return SIMCONNECT_RETRY_SECONDS
 
@@ -619,13 +725,18 @@ def telemetry_loop():
         if not isinstance(delay, (int, float)) or delay < 0:
             delay = TELEMETRY_INTERVAL_SECONDS
             _log_bridge(f"telemetry_loop_delay_invalid fallback_sec={delay}")
-        time.sleep(delay)
+        if _wakeup.wait(delay):
+            time.sleep(EVENT_SETTLE_SECONDS)
+            _wakeup.clear()
+            # The pushed values may be up to a period old; read them now.
+            if _telemetry is not None and _sm is not None and _sm.ok:
+                _telemetry.refresh()
 
 
-def set_values(payload):
+def set_values(payload) -> list[Command]:
     global _auto_ack_master_warn
     if not isinstance(payload, dict):
-        return
+        return []
 
     commands = _collect_commands(payload)
 
@@ -641,8 +752,8 @@ def set_values(payload):
             _reset_auto_ack_master_warn_state()
             continue
 
-    if not _sim_ready_for_commands():
-        return
+    if not _sim_ready_for_commands() or _commands is None:
+        return []
 
     for key, value in commands.items():
         if key == "auto_ack_master_warn":
@@ -652,29 +763,25 @@ def set_values(payload):
             parsed = _to_int(value)
             if parsed is None:
                 continue
-            if _force_set_simvar("TRANSPONDER_CODE:1", float(parsed)):
-                continue
+            # No BCD form (e.g. 7890), no fallback: XPNDR_SET without an
+            # argument would squawk 0000.
             bcd_value = _encode_transponder_bcd(parsed)
-            if bcd_value is not None:
-                _send_event("XPNDR_SET", bcd_value)
+            _commands.put("transponder", "TRANSPONDER_CODE:1", float(parsed), "XPNDR_SET" if bcd_value is not None else None, bcd_value)
             continue
 
         if key in ADF_ACTIVE_KEYS:
             parsed = _to_int(value)
             if parsed is None or parsed < 0:
                 continue
-            if _force_set_simvar("ADF_ACTIVE_FREQUENCY:1", float(parsed)):
-                continue
             bcd_value = _encode_decimal_bcd(parsed)
-            if bcd_value is not None:
-                _send_event("ADF_COMPLETE_SET", bcd_value)
+            _commands.put("adf_active", "ADF_ACTIVE_FREQUENCY:1", float(parsed), "ADF_COMPLETE_SET" if bcd_value is not None else None, bcd_value)
             continue
 
         if key in ADF_STANDBY_KEYS:
             parsed = _to_float(value)
             if parsed is None or parsed < 0:
                 continue
-            _force_set_simvar("ADF_STANDBY_FREQUENCY:1", float(round(parsed)))
+            _commands.put("adf_standby", "ADF_STANDBY_FREQUENCY:1", float(round(parsed)))
             continue
 
         if key == "gear_handle":
@@ -682,8 +789,7 @@ def set_values(payload):
             if parsed is None:
                 continue
             numeric = 1 if parsed else 0
-            if not _force_set_simvar("GEAR_HANDLE_POSITION", float(numeric)):
-                _send_event("GEAR_SET", numeric)
+            _commands.put("gear_handle", "GEAR_HANDLE_POSITION", float(numeric), "GEAR_SET", numeric)
             continue
 
         if key in FLAPS_KEYS:
@@ -693,8 +799,7 @@ def set_values(payload):
             flaps_index = int(round(parsed))
             if flaps_index < 0:
                 continue
-            if not _force_set_simvar("FLAPS_HANDLE_INDEX", float(flaps_index)):
-                _send_event("FLAPS_SET", max(0, min(flaps_index, 16383)))
+            _commands.put("flaps", "FLAPS_HANDLE_INDEX", float(flaps_index), "FLAPS_SET", max(0, min(flaps_index, 16383)))
             continue
 
         if key == "parking_brake":
@@ -702,7 +807,7 @@ def set_values(payload):
             if parsed is None:
                 continue
             numeric = 1 if parsed else 0
-            _force_set_simvar("BRAKE_PARKING_POSITION", float(numeric))
+            _commands.put("parking_brake", "BRAKE_PARKING_POSITION", float(numeric))
             continue
 
         if key == "autopilot_master":
@@ -710,5 +815,10 @@ def set_values(payload):
             if parsed is None:
                 continue
             numeric = 1 if parsed else 0
-            if not _force_set_simvar("AUTOPILOT_MASTER", float(numeric)):
-                _send_event("AUTOPILOT_ON" if parsed else "AUTOPILOT_OFF")
+            _commands.put("autopilot_master", "AUTOPILOT_MASTER", float(numeric), "AUTOPILOT_ON" if parsed else "AUTOPILOT_OFF")
+
+    # Everything queued above reaches the sim back to back.
+    outcomes = _commands.flush()
+    for command in outcomes:
+        _log_bridge(f"command target={command.target} status={command.status}")
+    return outcomes
@@ -1,20 +1,112 @@
 from flask import Flask, jsonify, render_template, request
 from SimConnect import *
+from SimConnect.Enum import SIMCONNECT_PERIOD
 from time import sleep
+import logging
+import os
 import random
+import threading
 
 
 app = Flask(__name__)
+LOGGER = logging.getLogger(__name__)
 
 # SIMCONNECTION RELATED STARTUPS
 
-# Create simconnection
-sm = SimConnect()
-ae = AircraftEvents(sm)
-aq = AircraftRequests(sm, _time=10)
+# Share the process-wide connection (the bridge uses the same one)
+broker = get_broker()
+sm = broker.sm
+ae = broker.events()
+aq = broker.requests(10, "server")
 
 # Create request holders
 
+# Everything the /ui endpoint shows is pushed by the sim once a second when it
+# changes, so page refreshes read sm.store instead of issuing a request each.
+request_ui_push = [
+	'FUEL_TOTAL_QUANTITY',
+	'FUEL_TOTAL_CAPACITY',
+	'AIRSPEED_INDICATED',
+	'PLANE_ALTITUDE',
+	'GEAR_HANDLE_POSITION',
+	'FLAPS_HANDLE_PERCENT',
+	'ELEVATOR_TRIM_PCT',
+	'RUDDER_TRIM_PCT',
+	'PLANE_LATITUDE',
+	'PLANE_LONGITUDE',
+	'MAGNETIC_COMPASS',
+	'VERTICAL_SPEED',
+	'AUTOPILOT_MASTER',
+	'AUTOPILOT_NAV_SELECTED',
+	'AUTOPILOT_WING_LEVELER',
+	'AUTOPILOT_HEADING_LOCK',
+	'AUTOPILOT_HEADING_LOCK_DIR',
+	'AUTOPILOT_ALTITUDE_LOCK',
+	'AUTOPILOT_ALTITUDE_LOCK_VAR',
+	'AUTOPILOT_ATTITUDE_HOLD',
+	'AUTOPILOT_GLIDESLOPE_HOLD',
+	'AUTOPILOT_APPROACH_HOLD',
+	'AUTOPILOT_BACKCOURSE_HOLD',
+	'AUTOPILOT_VERTICAL_HOLD',
+	'AUTOPILOT_VERTICAL_HOLD_VAR',
+	'AUTOPILOT_PITCH_HOLD',
+	'AUTOPILOT_PITCH_HOLD_REF',
+	'AUTOPILOT_FLIGHT_DIRECTOR_ACTIVE',
+	'AUTOPILOT_AIRSPEED_HOLD',
+	'AUTOPILOT_AIRSPEED_HOLD_VAR',
+	'CABIN_SEATBELTS_ALERT_SWITCH',
+	'CABIN_NO_SMOKING_ALERT_SWITCH',
+]
+ui_group = broker.subscribe("server", request_ui_push, SIMCONNECT_PERIOD.SIMCONNECT_PERIOD_SECOND, changed=True)
+
+# Facilities are warm-started from the cache file and indexed for
+# nearest/radius queries; lists coming into range are merged in as they arrive.
+FACILITY_CACHE = os.getenv("FACILITY_CACHE", os.path.join(os.path.dirname(os.path.abspath(__file__)), "facilities.cache"))
+fr = FacilitiesRequests(sm, FACILITY_CACHE)
+facility_index = FacilityIndex(fr.store)
+facility_lists = {
+	"airport": fr.Airports,
+	"waypoint": fr.Waypoints,
+	"ndb": fr.NDBs,
+	"vor": fr.VORs,
+}
+facilities_loading = threading.Event()
+facilities_lock = threading.Lock()
+
+
+def load_facilities():
+	# Fetch the lists the cache did not provide, save them once, then
+	# subscribe so facilities coming into range are merged in.
+	try:
+		fetched = False
+		for helper in fr.list:
+			if len(helper.table) == 0 and sm.ok:
+				helper.get()
+				fetched = helper.wait(30) or fetched
+		if fetched:
+			fr.save()
+		for helper in fr.list:
+			# facility_index follows the store, so the callback has nothing to do.
+			helper.subscribe(lambda table: None)
+	except Exception as err:
+		LOGGER.warning("facility load failed: %s" % (err))
+	finally:
+		facilities_loading.clear()
+
+
+def facilities_connected(_sm):
+	# Broker callback: runs on every (re)connect, off the request path.
+	with facilities_lock:
+		if facilities_loading.is_set():
+			return
+		facilities_loading.set()
+	threading.Thread(target=load_facilities, name="facilities", daemon=True).start()
+
+
+broker.on_connect(facilities_connected)
+if broker.connected:
+	facilities_connected(sm)
+
 # Note: I have commented out request_ui as I don't think it makes sense to replicate the ui interface through JSON given the /ui endpoint returns a duplicate of this anyway
 # I have not deleted it yet as it's handy to have this list of helpful variables here
 #
@@ -279,6 +371,17 @@ def AttInd():
 	return render_template("attitude-indicator/index.html")
 
 
+def get_pushed(datapoint_name, frame=None):
+	# Latest pushed value, falling back to a one-shot read before the first push.
+	# Pass one sm.store.frame() to read several values from the same state.
+	if frame is None:
+		frame = sm.store.frame()
+	value = frame.get(datapoint_name)
+	if value is None:
+		return aq.get(datapoint_name)
+	return value
+
+
 def get_dataset(data_type):
 	if data_type == "navigation": request_to_action = request_location
 	if data_type == "airspeed": request_to_action = request_airspeed
@@ -301,65 +404,64 @@ def output_ui_variables():
 
 	# Initialise dictionaru
 	ui_friendly_dictionary = {}
+	frame = sm.store.frame()
 	ui_friendly_dictionary["STATUS"] = "success"
 
 	# Fuel
-	ftotal = aq.get("FUEL_TOTAL_QUANTITY")
-	fcap = aq.get("FUEL_TOTAL_CAPACITY")
+	ftotal = get_pushed("FUEL_TOTAL_QUANTITY", frame)
+	fcap = get_pushed("FUEL_TOTAL_CAPACITY", frame)
 	fuel_percentage = ftotal / fcap * 100
 	ui_friendly_dictionary["FUEL_PERCENTAGE"] = round(fuel_percentage)
-	ui_friendly_dictionary["AIRSPEED_INDICATE"] = round(aq.get("AIRSPEED_INDICATED"))
-	ui_friendly_dictionary["ALTITUDE"] = thousandify(round(aq.get("PLANE_ALTITUDE")))
+	ui_friendly_dictionary["AIRSPEED_INDICATE"] = round(get_pushed("AIRSPEED_INDICATED", frame))
+	ui_friendly_dictionary["ALTITUDE"] = thousandify(round(get_pushed("PLANE_ALTITUDE", frame)))
 
 	# Control surfaces
-	if aq.get("GEAR_HANDLE_POSITION") == 1:
+	if get_pushed("GEAR_HANDLE_POSITION", frame) == 1:
 		ui_friendly_dictionary["GEAR_HANDLE_POSITION"] = "DOWN"
 	else:
 		ui_friendly_dictionary["GEAR_HANDLE_POSITION"] = "UP"
-	ui_friendly_dictionary["FLAPS_HANDLE_PERCENT"] = round(aq.get("FLAPS_HANDLE_PERCENT") * 100)
+	ui_friendly_dictionary["FLAPS_HANDLE_PERCENT"] = round(get_pushed("FLAPS_HANDLE_PERCENT", frame) * 100)
 
-	ui_friendly_dictionary["ELEVATOR_TRIM_PCT"] = round(aq.get("ELEVATOR_TRIM_PCT") * 100)
-	ui_friendly_dictionary["RUDDER_TRIM_PCT"] = round(aq.get("RUDDER_TRIM_PCT") * 100)
+	ui_friendly_dictionary["ELEVATOR_TRIM_PCT"] = round(get_pushed("ELEVATOR_TRIM_PCT", frame) * 100)
+	ui_friendly_dictionary["RUDDER_TRIM_PCT"] = round(get_pushed("RUDDER_TRIM_PCT", frame) * 100)
 
 	# Navigation
-	ui_friendly_dictionary["LATITUDE"] = aq.get("PLANE_LATITUDE")
-	ui_friendly_dictionary["LONGITUDE"] = aq.get("PLANE_LONGITUDE")
-	ui_friendly_dictionary["MAGNETIC_COMPASS"] = round(aq.get("MAGNETIC_COMPASS"))
-	ui_friendly_dictionary["VERTICAL_SPEED"] = round(aq.get("VERTICAL_SPEED"))
+	ui_friendly_dictionary["LATITUDE"] = get_pushed("PLANE_LATITUDE", frame)
+	ui_friendly_dictionary["LONGITUDE"] = get_pushed("PLANE_LONGITUDE", frame)
+	ui_friendly_dictionary["MAGNETIC_COMPASS"] = round(get_pushed("MAGNETIC_COMPASS", frame))
+	ui_friendly_dictionary["VERTICAL_SPEED"] = round(get_pushed("VERTICAL_SPEED", frame))
 
 	# Autopilot
-	ui_friendly_dictionary["AUTOPILOT_MASTER"] = aq.get("AUTOPILOT_MASTER")
-	ui_friendly_dictionary["AUTOPILOT_NAV_SELECTED"] = aq.get("AUTOPILOT_NAV_SELECTED")
-	ui_friendly_dictionary["AUTOPILOT_WING_LEVELER"] = aq.get("AUTOPILOT_WING_LEVELER")
-	ui_friendly_dictionary["AUTOPILOT_HEADING_LOCK"] = aq.get("AUTOPILOT_HEADING_LOCK")
-	ui_friendly_dictionary["AUTOPILOT_HEADING_LOCK_DIR"] = round(aq.get("AUTOPILOT_HEADING_LOCK_DIR"))
-	ui_friendly_dictionary["AUTOPILOT_ALTITUDE_LOCK"] = aq.get("AUTOPILOT_ALTITUDE_LOCK")
-	ui_friendly_dictionary["AUTOPILOT_ALTITUDE_LOCK_VAR"] = thousandify(round(aq.get("AUTOPILOT_ALTITUDE_LOCK_VAR")))
-	ui_friendly_dictionary["AUTOPILOT_ATTITUDE_HOLD"] = aq.get("AUTOPILOT_ATTITUDE_HOLD")
-	ui_friendly_dictionary["AUTOPILOT_GLIDESLOPE_HOLD"] = aq.get("AUTOPILOT_GLIDESLOPE_HOLD")
-	ui_friendly_dictionary["AUTOPILOT_APPROACH_HOLD"] = aq.get("AUTOPILOT_APPROACH_HOLD")
-	ui_friendly_dictionary["AUTOPILOT_BACKCOURSE_HOLD"] = aq.get("AUTOPILOT_BACKCOURSE_HOLD")
-	ui_friendly_dictionary["AUTOPILOT_VERTICAL_HOLD"] = aq.get("AUTOPILOT_VERTICAL_HOLD")
-	ui_friendly_dictionary["AUTOPILOT_VERTICAL_HOLD_VAR"] = aq.get("AUTOPILOT_VERTICAL_HOLD_VAR")
-	ui_friendly_dictionary["AUTOPILOT_PITCH_HOLD"] = aq.get("AUTOPILOT_PITCH_HOLD")
-	ui_friendly_dictionary["AUTOPILOT_PITCH_HOLD_REF"] = aq.get("AUTOPILOT_PITCH_HOLD_REF")
-	ui_friendly_dictionary["AUTOPILOT_FLIGHT_DIRECTOR_ACTIVE"] = aq.get("AUTOPILOT_FLIGHT_DIRECTOR_ACTIVE")
-	ui_friendly_dictionary["AUTOPILOT_AIRSPEED_HOLD"] = aq.get("AUTOPILOT_AIRSPEED_HOLD")
-	ui_friendly_dictionary["AUTOPILOT_AIRSPEED_HOLD_VAR"] = round(aq.get("AUTOPILOT_AIRSPEED_HOLD_VAR"))
+	ui_friendly_dictionary["AUTOPILOT_MASTER"] = get_pushed("AUTOPILOT_MASTER", frame)
+	ui_friendly_dictionary["AUTOPILOT_NAV_SELECTED"] = get_pushed("AUTOPILOT_NAV_SELECTED", frame)
+	ui_friendly_dictionary["AUTOPILOT_WING_LEVELER"] = get_pushed("AUTOPILOT_WING_LEVELER", frame)
+	ui_friendly_dictionary["AUTOPILOT_HEADING_LOCK"] = get_pushed("AUTOPILOT_HEADING_LOCK", frame)
+	ui_friendly_dictionary["AUTOPILOT_HEADING_LOCK_DIR"] = round(get_pushed("AUTOPILOT_HEADING_LOCK_DIR", frame))
+	ui_friendly_dictionary["AUTOPILOT_ALTITUDE_LOCK"] = get_pushed("AUTOPILOT_ALTITUDE_LOCK", frame)
+	ui_friendly_dictionary["AUTOPILOT_ALTITUDE_LOCK_VAR"] = thousandify(round(get_pushed("AUTOPILOT_ALTITUDE_LOCK_VAR", frame)))
+	ui_friendly_dictionary["AUTOPILOT_ATTITUDE_HOLD"] = get_pushed("AUTOPILOT_ATTITUDE_HOLD", frame)
+	ui_friendly_dictionary["AUTOPILOT_GLIDESLOPE_HOLD"] = get_pushed("AUTOPILOT_GLIDESLOPE_HOLD", frame)
+	ui_friendly_dictionary["AUTOPILOT_APPROACH_HOLD"] = get_pushed("AUTOPILOT_APPROACH_HOLD", frame)
+	ui_friendly_dictionary["AUTOPILOT_BACKCOURSE_HOLD"] = get_pushed("AUTOPILOT_BACKCOURSE_HOLD", frame)
+	ui_friendly_dictionary["AUTOPILOT_VERTICAL_HOLD"] = get_pushed("AUTOPILOT_VERTICAL_HOLD", frame)
+	ui_friendly_dictionary["AUTOPILOT_VERTICAL_HOLD_VAR"] = get_pushed("AUTOPILOT_VERTICAL_HOLD_VAR", frame)
+	ui_friendly_dictionary["AUTOPILOT_PITCH_HOLD"] = get_pushed("AUTOPILOT_PITCH_HOLD", frame)
+	ui_friendly_dictionary["AUTOPILOT_PITCH_HOLD_REF"] = get_pushed("AUTOPILOT_PITCH_HOLD_REF", frame)
+	ui_friendly_dictionary["AUTOPILOT_FLIGHT_DIRECTOR_ACTIVE"] = get_pushed("AUTOPILOT_FLIGHT_DIRECTOR_ACTIVE", frame)
+	ui_friendly_dictionary["AUTOPILOT_AIRSPEED_HOLD"] = get_pushed("AUTOPILOT_AIRSPEED_HOLD", frame)
+	ui_friendly_dictionary["AUTOPILOT_AIRSPEED_HOLD_VAR"] = round(get_pushed("AUTOPILOT_AIRSPEED_HOLD_VAR", frame))
 
 	# Cabin
-	ui_friendly_dictionary["CABIN_SEATBELTS_ALERT_SWITCH"] = aq.get("CABIN_SEATBELTS_ALERT_SWITCH")
-	ui_friendly_dictionary["CABIN_NO_SMOKING_ALERT_SWITCH"] = aq.get("CABIN_NO_SMOKING_ALERT_SWITCH")
+	ui_friendly_dictionary["CABIN_SEATBELTS_ALERT_SWITCH"] = get_pushed("CABIN_SEATBELTS_ALERT_SWITCH", frame)
+	ui_friendly_dictionary["CABIN_NO_SMOKING_ALERT_SWITCH"] = get_pushed("CABIN_NO_SMOKING_ALERT_SWITCH", frame)
 
 	return jsonify(ui_friendly_dictionary)
 
 
 @app.route('/dataset/<dataset_name>/', methods=["GET"])
 def output_json_dataset(dataset_name):
-	dataset_map = {}  #I have renamed map to dataset_map as map is used elsewhere
 	data_dictionary = get_dataset(dataset_name)
-	for datapoint_name in data_dictionary:
-		dataset_map[datapoint_name] = aq.get(datapoint_name)
+	dataset_map = aq.get_many(data_dictionary)  # all requests in flight at once
 	return jsonify(dataset_map)
 
 
@@ -367,9 +469,7 @@ def get_datapoint(datapoint_name, index=None):
 	# This function actually does the work of getting the datapoint
 
 	if index is not None and ':index' in datapoint_name:
-		dp = aq.find(datapoint_name)
-		if dp is not None:
-			dp.setIndex(int(index))
+		datapoint_name = datapoint_name.replace(':index', ':%d' % (int(index)))
 
 	return aq.get(datapoint_name)
 
@@ -393,9 +493,7 @@ def set_datapoint(datapoint_name, index=None, value_to_use=None):
 	# This function actually does the work of setting the datapoint
 
 	if index is not None and ':index' in datapoint_name:
-		clas = aq.find(datapoint_name)
-		if clas is not None:
-			clas.setIndex(int(index))
+		datapoint_name = datapoint_name.replace(':index', ':%d' % (int(index)))
 
 	sent = False
 	if value_to_use is None:
@@ -453,6 +551,52 @@ def trigger_event_endpoint(event_name):
 	return jsonify(status)
 
 
+def facility_query_position(ds):
+	# Query position from the request, defaulting to the user aircraft.
+	lat = ds.get('lat', type=float)
+	lon = ds.get('lon', type=float)
+	if lat is None or lon is None:
+		frame = sm.store.frame()
+		lat = get_pushed("PLANE_LATITUDE", frame)
+		lon = get_pushed("PLANE_LONGITUDE", frame)
+	return (lat, lon)
+
+
+@app.route('/facilities/<kind>/nearest', methods=["GET"])
+def facilities_nearest_endpoint(kind):
+	# ?k=5&limit_nm=50&lat=..&lon=..; lat/lon default to the aircraft position
+
+	if kind not in facility_lists:
+		return jsonify("Error: %s is not a facility type" % (kind)), 404
+	helper = facility_lists[kind]
+	if len(helper.table) == 0 and facilities_loading.is_set():
+		return jsonify("Error: facilities loading - try again shortly"), 503
+	(lat, lon) = facility_query_position(request.args)
+	if lat is None or lon is None:
+		return jsonify("Error: no position - is sim running?"), 503
+
+	k = request.args.get('k', default=1, type=int)
+	limit_nm = request.args.get('limit_nm', type=float)
+	return jsonify(facility_index.nearest(lat, lon, helper.item, k, limit_nm))
+
+
+@app.route('/facilities/<kind>/within', methods=["GET"])
+def facilities_within_endpoint(kind):
+	# ?radius_nm=25&lat=..&lon=..; lat/lon default to the aircraft position
+
+	if kind not in facility_lists:
+		return jsonify("Error: %s is not a facility type" % (kind)), 404
+	helper = facility_lists[kind]
+	if len(helper.table) == 0 and facilities_loading.is_set():
+		return jsonify("Error: facilities loading - try again shortly"), 503
+	(lat, lon) = facility_query_position(request.args)
+	if lat is None or lon is None:
+		return jsonify("Error: no position - is sim running?"), 503
+
+	radius_nm = request.args.get('radius_nm', default=25.0, type=float)
+	return jsonify(facility_index.within(lat, lon, radius_nm, helper.item))
+
+
 @app.route('/custom_emergency/<emergency_type>', methods=["GET", "POST"])
 def custom_emergency(emergency_type):
 
@@ -0,0 +1,4 @@
+import os
+
+# The suite runs against the in-process fake sim; it is never the default.
+os.environ.setdefault("SIMCONNECT_BACKEND", "fake")
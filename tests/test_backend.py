@@ -0,0 +1,27 @@
+import os
+import sys
+import unittest
+from unittest import mock
+
+from SimConnect.Backend import BACKEND_ENV, default_backend, load_backend
+from SimConnect.FakeSim import FakeSimConnectDll
+
+
+class BackendSelectionTest(unittest.TestCase):
+
+	def test_fake_is_opt_in_only(self):
+		with mock.patch.dict(os.environ, {}, clear=True):
+			self.assertEqual(default_backend(), "dll")
+		with mock.patch.dict(os.environ, {BACKEND_ENV: "fake"}):
+			self.assertEqual(default_backend(), "fake")
+			self.assertIsInstance(load_backend(None), FakeSimConnectDll)
+
+	@unittest.skipIf(sys.platform == "win32", "the DLL loads on Windows")
+	def test_dll_without_windows_fails_loudly(self):
+		with mock.patch.dict(os.environ, {}, clear=True):
+			with self.assertRaisesRegex(OSError, BACKEND_ENV + "=fake"):
+				load_backend(None)
+
+
+if __name__ == "__main__":
+	unittest.main()
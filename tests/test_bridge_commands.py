@@ -0,0 +1,139 @@
+import struct
+import time
+import unittest
+from ctypes import string_at
+
+import bridge.main as bridge
+from bridge.commands import FAILED, SENT, WRITTEN
+from SimConnect.Enum import (
+    SIMCONNECT_DATA_SET_FLAG,
+    SIMCONNECT_EXCEPTION,
+    SIMCONNECT_RECV_EXCEPTION,
+    SIMCONNECT_RECV_ID,
+)
+
+E_FAIL = -2147467259
+S_OK = 0
+
+
+class BridgeCommandTest(unittest.TestCase):
+
+    @classmethod
+    def setUpClass(cls):
+        bridge._ensure_simconnect()
+        assert bridge._broker.supervisor.connected.wait(5)
+
+    @classmethod
+    def tearDownClass(cls):
+        bridge._broker.stop()
+
+    def setUp(self):
+        dll = bridge._sm.dll
+        self.events = []
+        self.calls = []
+        self._set_data = dll.SetDataOnSimObject
+        self._transmit = dll.TransmitClientEvent
+
+        def transmit(hSimConnect, ObjectID, EventID, dwData, GroupID, Flags):
+            self.events.append((int(EventID), dwData.value))
+            self.calls.append("event")
+            return self._transmit(hSimConnect, ObjectID, EventID, dwData, GroupID, Flags)
+
+        # Every simvar write fails, so commands fall back to their event.
+        dll.SetDataOnSimObject = lambda *args: E_FAIL
+        dll.TransmitClientEvent = transmit
+
+    def tearDown(self):
+        dll = bridge._sm.dll
+        dll.SetDataOnSimObject = self._set_data
+        dll.TransmitClientEvent = self._transmit
+
+    def _status(self, commands, target):
+        return [command.status for command in commands if command.target == target]
+
+    def _event_id(self, name):
+        return bridge._ae.find(name).event.value
+
+    def _reject(self, simvar):
+        # Writes succeed, but a packet carrying simvar gets an exception
+        # once the test calls _settle(), as the sim sends it later.
+        dll = bridge._sm.dll
+        self.rejects = []
+
+        def set_data(hSimConnect, DefineID, ObjectID, Flags, ArrayCount, cbUnitSize, pDataSet):
+            hr = self._set_data(hSimConnect, DefineID, ObjectID, Flags, ArrayCount, cbUnitSize, pDataSet)
+            self.calls.append("write")
+            keys = bridge._commands._group.keys
+            if int(Flags) & SIMCONNECT_DATA_SET_FLAG.SIMCONNECT_DATA_SET_FLAG_TAGGED:
+                data = string_at(pDataSet, cbUnitSize)
+                # Every field here is a FLOAT64: (datum ID, value) pairs.
+                sent = [keys[i] for (i, _) in struct.iter_unpack("<Id", data)]
+            else:
+                sent = list(keys)
+            if simvar in sent:
+                self.rejects.append(dll.send_id)
+            return hr
+
+        dll.SetDataOnSimObject = set_data
+
+    def _settle(self, done):
+        # Deliver the pending exceptions until done() holds.
+        dll = bridge._sm.dll
+        deadline = time.monotonic() + 2
+        while not done() and time.monotonic() < deadline:
+            while self.rejects:
+                dll._post(dll._message(
+                    SIMCONNECT_RECV_EXCEPTION,
+                    SIMCONNECT_RECV_ID.SIMCONNECT_RECV_ID_EXCEPTION,
+                    dwException=SIMCONNECT_EXCEPTION.SIMCONNECT_EXCEPTION_DATA_ERROR,
+                    dwSendID=self.rejects.pop(0),
+                    dwIndex=0,
+                ))
+            time.sleep(0.05)
+
+    def test_valid_squawk_falls_back_to_xpndr_set(self):
+        commands = bridge.set_values({"squawk": 7700})
+        self.assertEqual(self._status(commands, "transponder"), [SENT])
+        self.assertEqual([value for (_, value) in self.events], [0x7700])
+
+    def test_invalid_squawk_sends_no_event(self):
+        commands = bridge.set_values({"squawk": 7890})
+        self.assertEqual(self._status(commands, "transponder"), [FAILED])
+        self.assertEqual(self.events, [])
+
+    def test_invalid_squawk_is_still_written(self):
+        bridge._sm.dll.SetDataOnSimObject = self._set_data
+        commands = bridge.set_values({"squawk": 7890})
+        self.assertEqual(self._status(commands, "transponder"), [WRITTEN])
+        self.assertEqual(self.events, [])
+
+    def test_not_settable_target_goes_straight_to_its_event(self):
+        bridge._sm.dll.SetDataOnSimObject = self._set_data
+        commands = bridge.set_values({"squawk": 1200})
+        self.assertEqual(self._status(commands, "transponder"), [SENT])
+        self.assertEqual(self.events, [(self._event_id("XPNDR_SET"), 0x1200)])
+
+    def test_commands_apply_in_queue_order(self):
+        self._reject(None)
+        commands = bridge.set_values({"squawk": 1200, "gear_handle": 1, "autopilot_master": 1})
+        self.assertEqual(self.calls, ["event", "write", "event"])
+        self.assertEqual(self._status(commands, "gear_handle"), [WRITTEN])
+
+    def test_rejected_write_falls_back_to_its_event(self):
+        self._reject("GEAR_HANDLE_POSITION")
+        commands = bridge.set_values({"gear_handle": 1})
+        self._settle(lambda: self.events)
+        self.assertEqual(self._status(commands, "gear_handle"), [SENT])
+        self.assertEqual(self.events, [(self._event_id("GEAR_SET"), 1)])
+
+    def test_rejected_batch_only_fails_the_bad_field(self):
+        self._reject("FLAPS_HANDLE_INDEX")
+        commands = bridge.set_values({"gear_handle": 0, "flaps_index": 2})
+        self._settle(lambda: self.events)
+        self.assertEqual(self._status(commands, "gear_handle"), [WRITTEN])
+        self.assertEqual(self._status(commands, "flaps"), [SENT])
+        self.assertEqual(self.events, [(self._event_id("FLAPS_SET"), 2)])
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,50 @@
+import unittest
+from unittest import mock
+
+import SimConnect.Broker as Broker
+from SimConnect import SimConnect, ConnectionBroker
+
+
+class BrokerRequestsTest(unittest.TestCase):
+
+	def setUp(self):
+		self.broker = ConnectionBroker(SimConnect(auto_connect=False, backend="fake"))
+
+	def test_ages_are_kept_per_consumer(self):
+		for _ in range(100):
+			self.broker.requests(2000, "bridge")
+		self.assertEqual(self.broker.ages, {"bridge": 2000})
+
+		aq = self.broker.requests(10, "server")
+		self.assertEqual(aq.time, 10)
+		self.assertEqual(len(self.broker.ages), 2)
+
+		# A consumer asking again replaces its own age.
+		self.broker.requests(500, "server")
+		self.assertEqual(aq.time, 500)
+
+	def test_requests_without_age_reuse_the_shared_cache(self):
+		aq = self.broker.requests(250, "bridge")
+		self.assertIs(self.broker.requests(), aq)
+		self.assertEqual(aq.time, 250)
+		self.assertEqual(self.broker.ages, {"bridge": 250})
+
+
+class GetBrokerTest(unittest.TestCase):
+
+	def test_settings_passed_after_creation_are_applied(self):
+		with mock.patch.object(Broker, "_broker", None):
+			# The server may import first and create the broker with defaults.
+			broker = Broker.get_broker()
+			try:
+				self.assertIs(Broker.get_broker(timeout=3, min_retry=1, max_retry=5), broker)
+				self.assertEqual(broker.supervisor.timeout, 3)
+				self.assertEqual(broker.supervisor.min_retry, 1)
+				self.assertEqual(broker.supervisor.max_retry, 5)
+				self.assertLessEqual(broker.supervisor.retry, 5)
+			finally:
+				broker.stop()
+
+
+if __name__ == "__main__":
+	unittest.main()
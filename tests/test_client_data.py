@@ -0,0 +1,104 @@
+import struct
+import time
+import unittest
+from ctypes import addressof, memmove, string_at
+
+from SimConnect import SimConnect, ClientDataChannel
+from SimConnect.DataLayout import DATA_OFFSET
+from SimConnect.Enum import SIMCONNECT_RECV_CLIENT_DATA, SIMCONNECT_RECV_ID
+
+
+def wait_for(predicate, timeout=2.0):
+	deadline = time.time() + timeout
+	while time.time() < deadline:
+		if predicate():
+			return True
+		time.sleep(.01)
+	return predicate()
+
+
+class ClientDataChannelTest(unittest.TestCase):
+	# The fake backend does not model client data, so the companion's side
+	# is played here: registry records are captured, value blocks posted.
+
+	def setUp(self):
+		self.sm = SimConnect(backend="fake")
+		dll = self.sm.dll
+		self.registry = []
+		self.definitions = []
+		set_client_data = dll.SetClientData
+		add_definition = dll.AddToClientDataDefinition
+
+		def capture_registry(hSimConnect, ClientDataID, DefineID, Flags, dwReserved, cbUnitSize, pDataSet):
+			self.registry.append(ClientDataChannel.REGISTRY.unpack(string_at(pDataSet, cbUnitSize)))
+			return set_client_data(hSimConnect, ClientDataID, DefineID, Flags, dwReserved, cbUnitSize, pDataSet)
+
+		def capture_definition(hSimConnect, DefineID, dwOffset, dwSizeOrType, fEpsilon, DatumID):
+			self.definitions.append((DefineID, dwSizeOrType))
+			return add_definition(hSimConnect, DefineID, dwOffset, dwSizeOrType, fEpsilon, DatumID)
+
+		dll.SetClientData = capture_registry
+		dll.AddToClientDataDefinition = capture_definition
+		self.channel = ClientDataChannel(self.sm)
+
+	def tearDown(self):
+		self.sm.exit()
+
+	def _publish(self, generation, values):
+		# One <prefix>.Values block as the companion writes it.
+		message = self.sm.dll._message(
+			SIMCONNECT_RECV_CLIENT_DATA,
+			SIMCONNECT_RECV_ID.SIMCONNECT_RECV_ID_CLIENT_DATA,
+			dwRequestID=self.channel.DATA_REQUEST_ID.value,
+			dwDefineID=self.channel.VALUES_DEFINITION_ID.value,
+			dwentrynumber=1,
+			dwoutof=1,
+			dwDefineCount=1,
+		)
+		data = ClientDataChannel.HEADER.pack(generation, len(values)) + struct.pack('<%dd' % (len(values)), *values)
+		memmove(addressof(message) + DATA_OFFSET, data, len(data))
+		self.sm.dll._post(message)
+
+	def test_registry_records(self):
+		self.assertTrue(self.channel.register({"ap": "(L:A32NX_AUTOPILOT_1_ACTIVE, bool)", "L:XMLVAR_Baro1_Mode": "L:XMLVAR_Baro1_Mode"}))
+		self.assertEqual([record[:3] for record in self.registry], [(1, 0, 2), (1, 1, 2)])
+		self.assertEqual([record[3].rstrip(b"\0") for record in self.registry], [
+			b"(L:A32NX_AUTOPILOT_1_ACTIVE, bool)",
+			# Bare names are wrapped into an expression.
+			b"(L:XMLVAR_Baro1_Mode)",
+		])
+		# The values definition covers the header and one FLOAT64 per value.
+		self.assertEqual(self.definitions[-1], (self.channel.VALUES_DEFINITION_ID.value, ClientDataChannel.HEADER.size + 16))
+
+	def test_values_reach_the_store(self):
+		self.channel.register(["L:A", "L:B"])
+		self._publish(1, [1.5, -2.0])
+		self.assertTrue(wait_for(lambda: self.channel.outData is not None))
+		frame = self.sm.store.frame()
+		self.assertEqual((frame.get("L:A"), frame.get("L:B")), (1.5, -2.0))
+		self.assertEqual(self.channel.get("L:B"), -2.0)
+
+	def test_blocks_of_an_older_registration_are_dropped(self):
+		self.channel.register(["L:A", "L:B"])
+		self.channel.register(["L:C"])
+		self.assertEqual(self.registry[-1][:3], (2, 0, 1))
+		self._publish(1, [1.0, 2.0])
+		self._publish(2, [3.0])
+		self.assertTrue(wait_for(lambda: self.channel.outData is not None))
+		self.assertEqual(list(self.channel.outData.keys), ["L:C"])
+		self.assertIsNone(self.sm.store.frame().get("L:A"))
+
+	def test_replay_sends_the_same_generation(self):
+		self.channel.register(["L:A"])
+		self.channel.defined = False
+		self.assertTrue(self.channel.replay())
+		self.assertEqual(self.registry, [self.registry[0]] * 2)
+
+	def test_too_many_values(self):
+		names = ["L:V%d" % (i) for i in range(ClientDataChannel.MAX_VALUES + 1)]
+		with self.assertRaises(ValueError):
+			self.channel.register(names)
+
+
+if __name__ == "__main__":
+	unittest.main()
@@ -0,0 +1,68 @@
+import unittest
+
+from SimConnect import DataStore, Snapshot
+
+
+class _Group(object):
+	# Stand-in for a publishing DefinitionGroup: one keys tuple per layout.
+
+	def __init__(self, keys):
+		self.keys = tuple(keys)
+
+	def snapshot(self, values, timestamp=0):
+		return Snapshot(self.keys, tuple(values), timestamp)
+
+
+class DataStoreTest(unittest.TestCase):
+
+	def test_frames_are_immutable(self):
+		store = DataStore()
+		group = _Group(["A", "B"])
+		store.publish(group.snapshot([1.0, 2.0]), group)
+		frame = store.frame()
+		store.publish(group.snapshot([3.0, 4.0]), group)
+		self.assertEqual(frame.json(), {"A": 1.0, "B": 2.0})
+		self.assertEqual(store.json(), {"A": 3.0, "B": 4.0})
+		self.assertEqual(store.seq, frame.seq + 1)
+
+	def test_publish_only_replaces_its_own_group(self):
+		store = DataStore()
+		big = _Group(["K%d" % (i) for i in range(1000)])
+		small = _Group(["X"])
+		store.publish(big.snapshot(range(1000), 10), big)
+		store.publish(small.snapshot([1.0], 20), small)
+		before = store.frame()
+		store.publish(small.snapshot([2.0], 30), small)
+		after = store.frame()
+		# Same key set: the key index and the other group's snapshot are shared.
+		self.assertIs(after.owners, before.owners)
+		self.assertIs(after.snapshots[big], before.snapshots[big])
+		self.assertEqual(after.get("X"), 2.0)
+		self.assertEqual(after.get("K999"), 999)
+		self.assertEqual(after.stamp("X"), 30)
+		self.assertEqual(after.stamp("K1"), 10)
+		self.assertIn("K5", after)
+		self.assertNotIn("nope", after)
+		self.assertIsNone(store.age("nope"))
+
+	def test_rebuilt_group_takes_over_its_keys(self):
+		store = DataStore()
+		old = _Group(["A", "B"])
+		store.publish(old.snapshot([1.0, 2.0]), old)
+		new = _Group(["A", "B", "C"])
+		store.publish(new.snapshot([5.0, 6.0, 7.0]), new)
+		self.assertEqual(store.json(), {"A": 5.0, "B": 6.0, "C": 7.0})
+		self.assertNotIn(old, store.frame().snapshots)
+
+	def test_clear(self):
+		store = DataStore()
+		group = _Group(["A"])
+		store.publish(group.snapshot([1.0]), group)
+		store.clear()
+		self.assertIsNone(store.get("A"))
+		store.publish(group.snapshot([2.0]), group)
+		self.assertEqual(store.get("A"), 2.0)
+
+
+if __name__ == "__main__":
+	unittest.main()
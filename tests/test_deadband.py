@@ -0,0 +1,65 @@
+import unittest
+
+from SimConnect import SimConnect, AircraftRequests
+from SimConnect.Deadband import DEFAULT_EPSILON, epsilon_for
+
+
+class EpsilonForTest(unittest.TestCase):
+
+	def test_base_name_covers_every_index(self):
+		self.assertEqual(epsilon_for("TURB_ENG_N1:3"), DEFAULT_EPSILON["TURB_ENG_N1"])
+
+	def test_overrides_win_exact_key_first(self):
+		overrides = {"TURB_ENG_N1": 1.0, "TURB_ENG_N1:2": 2.0}
+		self.assertEqual(epsilon_for("TURB_ENG_N1:2", overrides), 2.0)
+		self.assertEqual(epsilon_for("TURB_ENG_N1:1", overrides), 1.0)
+		self.assertEqual(epsilon_for("PLANE_ALTITUDE", overrides), DEFAULT_EPSILON["PLANE_ALTITUDE"])
+
+	def test_unknown_key_reports_every_change(self):
+		self.assertEqual(epsilon_for("NOT_A_SIMVAR"), 0)
+
+
+class DefinitionEpsilonTest(unittest.TestCase):
+
+	def setUp(self):
+		self.sm = SimConnect(backend="fake")
+		self.aq = AircraftRequests(self.sm, _epsilon={"PLANE_ALTITUDE": 5.0})
+
+	def tearDown(self):
+		self.sm.exit()
+
+	def _defined(self, define_id):
+		# {datum: epsilon} as passed to AddToDataDefinition.
+		return {deff[0]: deff[3] for deff in self.sm.dll.definitions[define_id]}
+
+	def test_group_passes_epsilon_to_the_definition(self):
+		group = self.aq.group(
+			["PLANE_LATITUDE", "PLANE_ALTITUDE", "TURB_ENG_N1:2", "TITLE"],
+			_epsilon={"TURB_ENG_N1:2": 0.5},
+		)
+		self.assertTrue(group._deff_test())
+		self.assertEqual(self._defined(group.DATA_DEFINITION_ID.value), {
+			b"PLANE LATITUDE": DEFAULT_EPSILON["PLANE_LATITUDE"],
+			b"PLANE ALTITUDE": 5.0,
+			b"TURB ENG N1:2": 0.5,
+			# Strings have no deadband.
+			b"TITLE": 0,
+		})
+
+	def test_group_overrides_stay_with_the_group(self):
+		self.aq.group(["PLANE_ALTITUDE"], _epsilon={"PLANE_ALTITUDE": 50.0})
+		group = self.aq.group(["PLANE_ALTITUDE"])
+		self.assertTrue(group._deff_test())
+		self.assertEqual(self._defined(group.DATA_DEFINITION_ID.value), {b"PLANE ALTITUDE": 5.0})
+
+	def test_request_passes_epsilon_to_the_definition(self):
+		request = self.aq.find("PLANE_ALTITUDE")
+		self.assertTrue(request._deff_test())
+		self.assertEqual(self._defined(request.DATA_DEFINITION_ID.value), {b"PLANE ALTITUDE": 5.0})
+		indexed = self.aq.find("TURB_ENG_N1:2")
+		self.assertTrue(indexed._deff_test())
+		self.assertEqual(self._defined(indexed.DATA_DEFINITION_ID.value), {b"TURB ENG N1:2": DEFAULT_EPSILON["TURB_ENG_N1"]})
+
+
+if __name__ == "__main__":
+	unittest.main()
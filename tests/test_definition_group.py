@@ -0,0 +1,65 @@
+import time
+import unittest
+
+from SimConnect import SimConnect, DefinitionGroup
+
+
+def wait_for(predicate, timeout=2.0):
+	deadline = time.time() + timeout
+	while time.time() < deadline:
+		if predicate():
+			return True
+		time.sleep(.01)
+	return predicate()
+
+
+class DefinitionGroupExceptionTest(unittest.TestCase):
+
+	def setUp(self):
+		self.sm = SimConnect(backend="fake")
+
+	def tearDown(self):
+		self.sm.exit()
+
+	def test_unknown_simvar_is_dropped_on_first_rejection(self):
+		self.sm.dll.rejected.add(b"NOT A SIMVAR")
+		group = DefinitionGroup([
+			("PLANE_ALTITUDE", b"PLANE ALTITUDE", b"feet"),
+			("NOT_A_SIMVAR", b"NOT A SIMVAR", b"feet"),
+			("AIRSPEED_INDICATED", b"AIRSPEED INDICATED", b"knots"),
+		], self.sm)
+		self.assertTrue(group._deff_test())
+
+		self.assertTrue(wait_for(lambda: group.disabled == ["NOT_A_SIMVAR"]))
+		self.assertEqual(group.keys, ["PLANE_ALTITUDE", "AIRSPEED_INDICATED"])
+		self.assertEqual(self.sm.dll.definitions[group.DATA_DEFINITION_ID.value][0][0], b"PLANE ALTITUDE")
+		self.assertEqual(len(self.sm.dll.definitions[group.DATA_DEFINITION_ID.value]), 2)
+
+		snapshot = group.get()
+		self.assertIsNotNone(snapshot)
+		self.assertEqual(list(snapshot.keys), ["PLANE_ALTITUDE", "AIRSPEED_INDICATED"])
+
+	def test_disable_does_not_interleave_with_a_definition_in_progress(self):
+		dll = self.sm.dll
+		dll.rejected.add(b"NOT A SIMVAR")
+		add = dll.AddToDataDefinition
+
+		def slow_add(*args):
+			# Let the dispatch thread see the rejection mid-definition.
+			time.sleep(.002)
+			return add(*args)
+
+		dll.AddToDataDefinition = slow_add
+		fields = [("PLANE_ALTITUDE", b"PLANE ALTITUDE", b"feet"), ("NOT_A_SIMVAR", b"NOT A SIMVAR", b"feet")]
+		fields += [("GENERAL_ENG_RPM:%d" % (i), b"GENERAL ENG RPM:%d" % (i), b"rpm") for i in range(1, 41)]
+		group = DefinitionGroup(fields, self.sm)
+		group._deff_test()
+
+		self.assertTrue(wait_for(lambda: group.disabled == ["NOT_A_SIMVAR"] and group.defined))
+		defined = [deff[0] for deff in dll.definitions[group.DATA_DEFINITION_ID.value]]
+		self.assertEqual(defined, [deff[0] for deff in group.definitions])
+		self.assertEqual(group._layout.size, 8 * len(group.keys))
+
+
+if __name__ == "__main__":
+	unittest.main()
@@ -0,0 +1,41 @@
+import unittest
+
+from SimConnect import SimConnect
+from SimConnect.Dispatch import ThreadEventWait
+
+
+class CountingWait(ThreadEventWait):
+	"""ThreadEventWait that owns a handle per connection, like Win32EventWait."""
+
+	def __init__(self):
+		super().__init__()
+		self.handle = None
+		self.opened = 0
+		self.closed = 0
+
+	def open(self):
+		if self.handle is None:
+			self.handle = self
+			self.opened += 1
+
+	def close(self):
+		if self.handle is not None:
+			self.handle = None
+			self.closed += 1
+
+
+class WaitHandleLifetimeTest(unittest.TestCase):
+
+	def test_every_connection_closes_its_handle(self):
+		wait = CountingWait()
+		sm = SimConnect(auto_connect=False, wait_strategy=wait, backend="fake")
+		for _ in range(3):
+			sm.connect(5)
+			self.assertIsNotNone(wait.handle)
+			sm.exit()
+			self.assertIsNone(wait.handle)
+		self.assertEqual((wait.opened, wait.closed), (3, 3))
+
+
+if __name__ == "__main__":
+	unittest.main()
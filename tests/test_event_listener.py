@@ -0,0 +1,92 @@
+import time
+import unittest
+
+from SimConnect import SimConnect, EventListener
+from SimConnect.Enum import DWORD
+
+
+def wait_for(predicate, timeout=2.0):
+	deadline = time.time() + timeout
+	while time.time() < deadline:
+		if predicate():
+			return True
+		time.sleep(.01)
+	return predicate()
+
+
+class EventListenerTest(unittest.TestCase):
+
+	def setUp(self):
+		self.sm = SimConnect(backend="fake")
+		self.listener = EventListener(self.sm)
+		self.heard = []
+
+	def tearDown(self):
+		self.sm.exit()
+
+	def _hear(self, name, data):
+		self.heard.append((name, data))
+
+	def test_cockpit_event_reaches_the_callback(self):
+		self.assertTrue(self.listener.on("XPNDR_SET", self._hear))
+		self.sm.dll.cockpit(b"XPNDR_SET", 0x7700)
+		self.assertTrue(wait_for(lambda: self.heard))
+		self.assertEqual(self.heard, [("XPNDR_SET", 0x7700)])
+
+	def test_events_this_client_sends_are_reported_too(self):
+		self.listener.on("GEAR_UP", self._hear)
+		self.sm.send_event(self.sm.map_to_sim_event(b"GEAR_UP"), DWORD(0))
+		self.assertTrue(wait_for(lambda: self.heard))
+		self.assertEqual(self.heard, [("GEAR_UP", 0)])
+
+	def test_one_group_entry_per_event(self):
+		other = []
+		self.listener.on("GEAR_UP", self._hear)
+		self.listener.on("GEAR_UP", lambda name, data: other.append(name))
+		evnt = self.sm.map_to_sim_event(b"GEAR_UP")
+		self.assertEqual(self.sm.dll.groups, {evnt.value: self.listener.group.value})
+		self.assertEqual(self.sm.session.priorities, {self.listener.group.value: self.listener.priority})
+		self.sm.dll.cockpit(b"GEAR_UP")
+		self.assertTrue(wait_for(lambda: self.heard and other))
+
+	def test_failing_callback_does_not_stop_the_others(self):
+		def fail(name, data):
+			raise RuntimeError(name)
+
+		self.listener.on("GEAR_DOWN", fail)
+		self.listener.on("GEAR_DOWN", self._hear)
+		with self.assertLogs("SimConnect", "ERROR"):
+			self.sm.dll.cockpit(b"GEAR_DOWN")
+			self.assertTrue(wait_for(lambda: self.heard))
+
+	def test_off(self):
+		other = []
+		self.listener.on("GEAR_UP", self._hear)
+		self.listener.on("GEAR_UP", other.append)
+		self.listener.off("GEAR_UP", other.append)
+		self.sm.dll.cockpit(b"GEAR_UP")
+		self.assertTrue(wait_for(lambda: self.heard))
+		self.assertEqual(other, [])
+		self.listener.off("GEAR_UP")
+		self.assertEqual(self.listener.callbacks[self.sm.map_to_sim_event(b"GEAR_UP").value], [])
+
+	def test_registered_while_disconnected(self):
+		self.sm.exit()
+		self.assertFalse(self.listener.on("GEAR_UP", self._hear))
+		self.sm.connect()
+		self.assertTrue(self.listener.attach())
+		self.sm.dll.cockpit(b"GEAR_UP")
+		self.assertTrue(wait_for(lambda: self.heard))
+
+	def test_release(self):
+		self.listener.on("GEAR_UP", self._hear)
+		group = self.listener.group.value
+		self.listener.release()
+		self.assertEqual(self.sm.dll.groups, {})
+		self.assertNotIn(group, self.sm.listeners)
+		self.assertNotIn(group, self.sm.session.priorities)
+		self.assertEqual([entry for entry in self.sm.session.notifications if entry[0] == group], [])
+
+
+if __name__ == "__main__":
+	unittest.main()
@@ -0,0 +1,67 @@
+import os
+import shutil
+import struct
+import tempfile
+import unittest
+
+from SimConnect.FacilityStore import FacilityStore, FacilityTable, AIRPORT, VOR
+
+
+class FacilityStoreCacheTest(unittest.TestCase):
+
+	def setUp(self):
+		self.dir = tempfile.mkdtemp()
+		self.path = os.path.join(self.dir, "facilities.cache")
+
+	def tearDown(self):
+		shutil.rmtree(self.dir, ignore_errors=True)
+
+	def _write(self, data):
+		with open(self.path, "wb") as fp:
+			fp.write(data)
+
+	def _saved(self):
+		store = FacilityStore()
+		store.tables[AIRPORT] = FacilityTable(AIRPORT, rows=50)
+		store.tables[VOR] = FacilityTable(VOR, rows=20)
+		store.save(self.path)
+		with open(self.path, "rb") as fp:
+			return fp.read()
+
+	def assertStartsEmpty(self):
+		store = FacilityStore(self.path)
+		self.assertTrue(all(len(table) == 0 for table in store.tables.values()))
+		# The bad file was replaced with a valid, empty cache.
+		self.assertEqual(len(FacilityStore(self.path).table(AIRPORT)), 0)
+		return store
+
+	def test_round_trip(self):
+		self._saved()
+		store = FacilityStore(self.path)
+		self.assertEqual(len(store.table(AIRPORT)), 50)
+		self.assertEqual(len(store.table(VOR)), 20)
+
+	def test_empty_file(self):
+		self._write(b"")
+		self.assertStartsEmpty()
+
+	def test_garbage(self):
+		self._write(os.urandom(3) + b"not a facility cache" * 10)
+		self.assertStartsEmpty()
+
+	def test_shorter_than_header(self):
+		self._write(b"OSF")
+		self.assertStartsEmpty()
+
+	def test_truncated(self):
+		self._write(self._saved()[:200])
+		self.assertStartsEmpty()
+
+	def test_old_version(self):
+		data = self._saved()
+		self._write(data[:4] + struct.pack("<I", 0) + data[8:])
+		self.assertStartsEmpty()
+
+
+if __name__ == "__main__":
+	unittest.main()
@@ -0,0 +1,49 @@
+import threading
+import unittest
+
+from SimConnect.IdAllocator import IdAllocator
+
+
+class IdAllocatorTest(unittest.TestCase):
+
+	def test_recycles_released_ids(self):
+		ids = IdAllocator(3, "Request")
+		a = ids.acquire()
+		ids.acquire()
+		ids.release(a)
+		self.assertEqual(ids.acquire(), a)
+		self.assertEqual(len(ids), 2)
+
+	def test_double_release_is_rejected(self):
+		ids = IdAllocator()
+		a = ids.acquire()
+		ids.release(a)
+		with self.assertRaises(ValueError):
+			ids.release(a)
+		self.assertEqual(ids.free, [int(a)])
+		self.assertNotEqual(ids.acquire(), ids.acquire())
+
+	def test_release_of_unknown_id_is_rejected(self):
+		ids = IdAllocator(5)
+		with self.assertRaises(ValueError):
+			ids.release(5)
+
+	def test_concurrent_acquire_hands_out_unique_ids(self):
+		ids = IdAllocator()
+		seen = []
+
+		def worker():
+			for _ in range(500):
+				seen.append(int(ids.acquire()))
+
+		threads = [threading.Thread(target=worker) for _ in range(8)]
+		for thread in threads:
+			thread.start()
+		for thread in threads:
+			thread.join()
+		self.assertEqual(len(set(seen)), len(seen))
+		self.assertEqual(len(ids), len(seen))
+
+
+if __name__ == "__main__":
+	unittest.main()
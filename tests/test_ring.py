@@ -0,0 +1,113 @@
+import os
+import shutil
+import subprocess
+import sys
+import tempfile
+import unittest
+from collections import deque
+from ctypes import addressof, byref, string_at
+from ctypes.wintypes import HANDLE
+from unittest import mock
+
+from SimConnect.Enum import SIMCONNECT_DATATYPE, SIMCONNECT_SIMOBJECT_TYPE
+from SimConnect.FakeSim import FakeSimConnectDll
+from SimConnect.Ring import RING_ENV, NativeRing, PyRing, default_ring, in_process_next_dispatch, load_native
+
+_SOURCE = os.path.join(os.path.dirname(__file__), "..", "SimConnect", "native", "ringdrain.c")
+
+
+class _Sm(object):
+	# The parts of SimConnect a ring uses.
+
+	def __init__(self, dll, handle):
+		self.dll = dll
+		self.hSimConnect = handle
+
+	def IsHR(self, hr, value):
+		return (hr & 0xFFFFFFFF) == value
+
+
+def _stream():
+	# A mixed queue: OPEN, exceptions, system state and by-type data of
+	# different sizes.
+	dll = FakeSimConnectDll()
+	handle = HANDLE()
+	dll.Open(byref(handle), b"ring", None, 0, None, 0)
+	dll.Close(handle)
+	dll.rejected.add(b"NOT A SIMVAR")
+	dll.AddToDataDefinition(handle, 1, b"PLANE ALTITUDE", b"feet")
+	dll.AddToDataDefinition(handle, 1, b"ATC ID", None, SIMCONNECT_DATATYPE.SIMCONNECT_DATATYPE_STRING256)
+	dll.AddToDataDefinition(handle, 1, b"NOT A SIMVAR", b"feet")
+	dll.AddToDataDefinition(handle, 2, b"PLANE LATITUDE", b"degrees")
+	for _ in range(20):
+		dll.RequestDataOnSimObjectType(handle, 1, 1, 200000, SIMCONNECT_SIMOBJECT_TYPE.SIMCONNECT_SIMOBJECT_TYPE_AIRCRAFT)
+		dll.RequestDataOnSimObjectType(handle, 2, 2, 0, SIMCONNECT_SIMOBJECT_TYPE.SIMCONNECT_SIMOBJECT_TYPE_USER)
+		dll.RequestSystemState(handle, 3, b"FlightLoaded")
+	dll.RequestDataOnSimObjectType(handle, 4, 99, 0, SIMCONNECT_SIMOBJECT_TYPE.SIMCONNECT_SIMOBJECT_TYPE_USER)
+	return (dll, handle, list(dll.queue))
+
+
+def _batch(ring, sm, messages):
+	sm.dll.queue = deque(messages)
+	batches = []
+	while True:
+		count = ring.drain(sm)
+		if count == 0:
+			return batches
+		batches.append([
+			(ring.offsets[i], ring.sizes[i], string_at(ring.address + ring.offsets[i], ring.sizes[i]))
+			for i in range(count)
+		])
+
+
+class RingTest(unittest.TestCase):
+
+	@classmethod
+	def setUpClass(cls):
+		cls.dir = tempfile.mkdtemp()
+		cls.lib = None
+		compiler = shutil.which("cc") or shutil.which("gcc")
+		if compiler is None or sys.platform == "win32":
+			return
+		name = "libringdrain.dylib" if sys.platform == "darwin" else "libringdrain.so"
+		subprocess.run(
+			[compiler, "-O2", "-shared", "-fPIC", _SOURCE, "-o", os.path.join(cls.dir, name)],
+			check=True,
+		)
+		cls.lib = load_native(cls.dir)
+
+	@classmethod
+	def tearDownClass(cls):
+		shutil.rmtree(cls.dir, ignore_errors=True)
+
+	def test_pyring_copies_every_message(self):
+		(dll, handle, messages) = _stream()
+		batches = _batch(PyRing(), _Sm(dll, handle), messages)
+		records = [record for batch in batches for record in batch]
+		self.assertEqual(len(records), len(messages))
+		self.assertEqual([record[2] for record in records], [string_at(addressof(m), size) for m, (offset, size, data) in zip(messages, records)])
+		self.assertTrue(all(offset % 8 == 0 for (offset, size, data) in records))
+
+	def test_native_and_python_rings_produce_the_same_batches(self):
+		if self.lib is None:
+			self.skipTest("no C compiler to build ringdrain.c")
+		(dll, handle, messages) = _stream()
+		sm = _Sm(dll, handle)
+		# Small buffers so the stream spans several batches.
+		python = _batch(PyRing(capacity=4096, max_records=16), sm, messages)
+		native = _batch(NativeRing(self.lib, in_process_next_dispatch(dll), capacity=4096, max_records=16), sm, messages)
+		self.assertGreater(len(python), 1)
+		self.assertEqual(native, python)
+
+	def test_in_process_backends_use_a_ring_only_when_asked(self):
+		dll = FakeSimConnectDll()
+		with mock.patch.dict(os.environ, {RING_ENV: ""}):
+			self.assertIsNone(default_ring(dll))
+		with mock.patch.dict(os.environ, {RING_ENV: "python"}):
+			self.assertIsInstance(default_ring(dll), PyRing)
+		with mock.patch.dict(os.environ, {RING_ENV: "off"}):
+			self.assertIsNone(default_ring(dll))
+
+
+if __name__ == "__main__":
+	unittest.main()
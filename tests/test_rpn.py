@@ -0,0 +1,40 @@
+import unittest
+
+from SimConnect.Rpn import RpnEngine, RpnError
+
+
+class RpnCompileTest(unittest.TestCase):
+
+	def test_literals_and_variables(self):
+		engine = RpnEngine()
+		engine.add("ann", "(L:A32NX_OVHD_INTLT_ANN, Number) 2 == if{ 0.1 } els{ 1 } 1.5e2 *")
+		engine.set("L:A32NX_OVHD_INTLT_ANN", 2)
+		self.assertAlmostEqual(engine.update()["ann"], 15.0)
+
+	def test_non_finite_literals_are_unknown_tokens(self):
+		engine = RpnEngine()
+		for token in ("nan", "NaN", "inf", "-inf", "Infinity", "1e999", "-1e999"):
+			with self.assertRaisesRegex(RpnError, "Unknown token"):
+				engine.compile("(L:X) %s +" % (token))
+
+	def test_register_store_in_untaken_branch_does_not_leak(self):
+		engine = RpnEngine()
+		engine.add("r", "1 s0 p (A:X,Bool) if{ 2 s0 p } l0")
+		engine.add("e", "1 s0 p (A:X,Bool) if{ 2 s0 p } els{ 3 s1 p } l0 l1 +")
+		engine.set("A:X", 0)
+		self.assertEqual(engine.update(), {"r": 1.0, "e": 4.0})
+		engine.set("A:X", 1)
+		self.assertEqual(engine.update(), {"r": 2.0, "e": 2.0})
+
+	def test_failing_expression_does_not_stop_the_others(self):
+		engine = RpnEngine()
+		engine.add("bad", "(L:X) 1e300 1e300 * int")
+		engine.add("good", "(L:X) 2 *")
+		engine.set("L:X", 3)
+		changed = engine.update()
+		self.assertEqual(changed, {"good": 6.0})
+		self.assertIsNone(engine.get("bad"))
+
+
+if __name__ == "__main__":
+	unittest.main()
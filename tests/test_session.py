@@ -0,0 +1,78 @@
+import time
+import unittest
+
+from SimConnect import SimConnect, AircraftRequests
+from SimConnect.Enum import SIMCONNECT_PERIOD
+
+
+def wait_for(predicate, timeout=2.0):
+	deadline = time.time() + timeout
+	while time.time() < deadline:
+		if predicate():
+			return True
+		time.sleep(.01)
+	return predicate()
+
+
+class SessionReplayTest(unittest.TestCase):
+
+	def setUp(self):
+		self.sm = SimConnect(backend="fake")
+		self.aq = AircraftRequests(self.sm)
+
+	def tearDown(self):
+		self.sm.exit()
+
+	def _reconnect(self):
+		# The fake forgets every definition, mapping and subscription on Open.
+		self.sm.exit()
+		self.sm.connect()
+
+	def test_subscription_resumes_with_the_same_ids(self):
+		group = self.aq.subscribe(["PLANE_ALTITUDE", "AIRSPEED_INDICATED"], SIMCONNECT_PERIOD.SIMCONNECT_PERIOD_SIM_FRAME)
+		self.assertTrue(wait_for(lambda: self.sm.store.frame().get("PLANE_ALTITUDE") is not None))
+		(define_id, request_id) = (group.DATA_DEFINITION_ID.value, group.DATA_REQUEST_ID.value)
+
+		self._reconnect()
+		dll = self.sm.dll
+		self.assertEqual(self.sm.session.replays, 2)
+		self.assertEqual((group.DATA_DEFINITION_ID.value, group.DATA_REQUEST_ID.value), (define_id, request_id))
+		self.assertEqual([deff[0] for deff in dll.definitions[define_id]], [b"PLANE ALTITUDE", b"AIRSPEED INDICATED"])
+		self.assertIn(request_id, dll.subscriptions)
+
+		# Pushed data resumes without the consumer doing anything.
+		seq = self.sm.store.frame().seq
+		self.assertTrue(wait_for(lambda: self.sm.store.frame().seq > seq))
+
+	def test_values_from_the_old_connection_are_dropped(self):
+		group = self.aq.group(["PLANE_ALTITUDE"])
+		self.assertIsNotNone(group.get())
+		self.sm.exit()
+		self.sm.session.reset()
+		self.assertIsNone(group.outData)
+		self.assertFalse(group.defined)
+		self.sm.connect()
+		self.assertTrue(group.defined)
+		self.assertIsNotNone(group.get())
+
+	def test_requests_keep_working(self):
+		request = self.aq.find("PLANE_ALTITUDE")
+		self.assertIsNotNone(request.get())
+		define_id = request.DATA_DEFINITION_ID.value
+		self._reconnect()
+		self.assertEqual(request.DATA_DEFINITION_ID.value, define_id)
+		self.assertIn(define_id, self.sm.dll.definitions)
+		self.assertIsNotNone(request.get())
+
+	def test_events_and_notification_groups_are_replayed(self):
+		evnt = self.sm.map_to_sim_event(b"GEAR_UP")
+		self.sm.add_to_notification_group(7, evnt)
+		self.sm.set_notification_group_priority(7)
+		self._reconnect()
+		dll = self.sm.dll
+		self.assertEqual(dll.events[evnt.value], b"GEAR_UP")
+		self.assertEqual(dll.groups[evnt.value], 7)
+
+
+if __name__ == "__main__":
+	unittest.main()
@@ -0,0 +1,85 @@
+import time
+import unittest
+
+from SimConnect import SimConnect, SimStateTracker
+from SimConnect.SimState import DISCONNECTED, MENU, FLYING, PAUSED, CRASHED
+
+
+def wait_for(predicate, timeout=2.0):
+	deadline = time.time() + timeout
+	while time.time() < deadline:
+		if predicate():
+			return True
+		time.sleep(.01)
+	return predicate()
+
+
+class SimStateTrackerTest(unittest.TestCase):
+
+	def setUp(self):
+		self.sm = SimConnect(backend="fake")
+		self.dll = self.sm.dll
+		self.tracker = SimStateTracker(self.sm)
+		self.changes = []
+		self.tracker.on_change(lambda old, new: self.changes.append((old, new)))
+		# The answers to the state requests name the loaded files.
+		self.assertTrue(wait_for(lambda: self.tracker.aircraft is not None))
+
+	def tearDown(self):
+		self.sm.exit()
+
+	def assertReaches(self, state):
+		self.assertTrue(self.tracker.wait(state, 2), "%s, not %s" % (self.tracker.state, state))
+
+	def test_initial_state_comes_from_the_state_requests(self):
+		self.assertEqual(self.tracker.state, FLYING)
+		self.assertTrue(self.tracker.active)
+		self.assertEqual(self.tracker.flight, self.dll.model.flight.decode())
+		self.assertEqual(self.tracker.aircraft, self.dll.model.aircraft.decode())
+		self.assertTrue(self.tracker.is_flight_loaded())
+
+	def test_pause(self):
+		self.dll.pause(True)
+		self.assertReaches(PAUSED)
+		self.assertFalse(self.tracker.active)
+		self.dll.pause(False)
+		self.assertReaches(FLYING)
+		self.assertEqual(self.changes, [(FLYING, PAUSED), (PAUSED, FLYING)])
+
+	def test_menu(self):
+		self.dll.run(False)
+		self.assertReaches(MENU)
+		self.assertFalse(self.tracker.is_flight_loaded())
+		self.dll.run(True)
+		self.assertReaches(FLYING)
+
+	def test_crash_lasts_until_reset_or_a_new_flight(self):
+		self.dll.crash()
+		self.assertReaches(CRASHED)
+		# Pausing a crashed flight does not hide the crash.
+		self.dll.pause(True)
+		self.dll.crash_reset()
+		self.assertReaches(PAUSED)
+		self.dll.crash()
+		self.assertReaches(CRASHED)
+		self.dll.load(flight=b"Missions\\Fake\\Other.FLT")
+		self.assertReaches(PAUSED)
+		self.assertEqual(self.tracker.flight, "Missions\\Fake\\Other.FLT")
+
+	def test_aircraft_loaded(self):
+		self.dll.load(aircraft=b"SimObjects\\Airplanes\\Other\\aircraft.cfg")
+		self.assertTrue(wait_for(lambda: self.tracker.aircraft == "SimObjects\\Airplanes\\Other\\aircraft.cfg"))
+		self.assertEqual(self.tracker.state, FLYING)
+
+	def test_reconnect(self):
+		self.sm.exit()
+		self.assertEqual(self.tracker.update(), DISCONNECTED)
+		self.dll.model.running = False
+		self.sm.connect()
+		# Asked again on the new connection rather than remembered.
+		self.assertReaches(MENU)
+		self.assertEqual(self.changes, [(FLYING, DISCONNECTED), (DISCONNECTED, MENU)])
+
+
+if __name__ == "__main__":
+	unittest.main()
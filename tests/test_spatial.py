@@ -0,0 +1,84 @@
+import math
+import random
+import unittest
+
+from SimConnect.FacilityStore import FacilityStore, FacilityTable, RECORDS, AIRPORT
+from SimConnect.Spatial import GridIndex, FacilityIndex, EARTH_RADIUS_NM
+
+
+def _distance(lat1, lon1, lat2, lon2):
+	(p1, p2) = (math.radians(lat1), math.radians(lat2))
+	dlon = math.radians(lon2 - lon1)
+	c = math.sin(p1) * math.sin(p2) + math.cos(p1) * math.cos(p2) * math.cos(dlon)
+	return EARTH_RADIUS_NM * math.acos(max(-1.0, min(1.0, c)))
+
+
+def _airports(rows):
+	# FacilityTable built from wire records: [(icao, lat, lon)].
+	record = RECORDS[AIRPORT]
+	data = b"".join(record.pack(icao.encode(), lat, lon, 0.0) for (icao, lat, lon) in rows)
+	return FacilityTable.from_records(AIRPORT, data)
+
+
+class GridIndexTest(unittest.TestCase):
+
+	def setUp(self):
+		rng = random.Random(19)
+		self.points = [(rng.uniform(-89.0, 89.0), rng.uniform(-180.0, 180.0)) for _ in range(2000)]
+		# A cluster across the antimeridian and one near the pole.
+		self.points += [(rng.uniform(-2.0, 2.0), rng.choice((-1, 1)) * rng.uniform(178.0, 180.0)) for _ in range(200)]
+		self.points += [(rng.uniform(87.0, 90.0), rng.uniform(-180.0, 180.0)) for _ in range(200)]
+		self.grid = GridIndex(1.0)
+		for (n, (lat, lon)) in enumerate(self.points):
+			self.grid.add(n, lat, lon)
+
+	def _brute(self, lat, lon):
+		return sorted((_distance(lat, lon, plat, plon), n) for (n, (plat, plon)) in enumerate(self.points))
+
+	def test_nearest_matches_brute_force(self):
+		for (lat, lon) in [(47.4, -122.3), (0.0, 179.9), (0.5, -179.5), (89.5, 10.0), (-60.0, 0.0)]:
+			expected = self._brute(lat, lon)[:5]
+			found = self.grid.nearest(lat, lon, 5)
+			self.assertEqual([n for (_, n) in found], [n for (_, n) in expected])
+			for ((d, _), (e, _)) in zip(found, expected):
+				self.assertAlmostEqual(d, e, places=6)
+
+	def test_nearest_limit(self):
+		(lat, lon) = (0.0, 179.9)
+		expected = [n for (d, n) in self._brute(lat, lon) if d <= 60.0][:50]
+		self.assertEqual([n for (_, n) in self.grid.nearest(lat, lon, 50, limit_nm=60.0)], expected)
+
+	def test_within_matches_brute_force(self):
+		for (lat, lon, radius) in [(0.0, -179.9, 120.0), (88.5, 45.0, 200.0), (10.0, 10.0, 600.0)]:
+			expected = [n for (d, n) in self._brute(lat, lon) if d <= radius]
+			self.assertEqual([n for (_, n) in self.grid.within(lat, lon, radius)], expected)
+
+	def test_move_changes_cell(self):
+		self.grid.move(0, 47.45, -122.31)
+		self.assertEqual(self.grid.nearest(47.45, -122.31, 1)[0][1], 0)
+		self.points[0] = (47.45, -122.31)
+		expected = [n for (d, n) in self._brute(10.0, 10.0) if d <= 600.0]
+		self.assertEqual([n for (_, n) in self.grid.within(10.0, 10.0, 600.0)], expected)
+
+
+class FacilityIndexTest(unittest.TestCase):
+
+	def test_merge_moves_replaced_rows(self):
+		store = FacilityStore()
+		store.tables[AIRPORT] = _airports([("KSEA", 47.45, -122.31), ("KPDX", 45.59, -122.60)])
+		index = FacilityIndex(store)
+		self.assertEqual(index.nearest(47.45, -122.31)[0]["icao"], "KSEA")
+
+		# A subscription delta moves KSEA far away and adds KBFI.
+		merged = store.table(AIRPORT).merge(_airports([("KSEA", 10.0, 10.0), ("KBFI", 47.53, -122.30)]))
+		self.assertEqual(list(merged.replaced), [0])
+		store.tables[AIRPORT] = merged
+		index.update(AIRPORT, merged, False)
+
+		self.assertEqual(len(index.grids[AIRPORT]), 3)
+		self.assertEqual([row["icao"] for row in index.nearest(47.45, -122.31, k=2)], ["KBFI", "KPDX"])
+		self.assertEqual([row["icao"] for row in index.within(10.0, 10.0, 5.0)], ["KSEA"])
+
+
+if __name__ == "__main__":
+	unittest.main()
@@ -0,0 +1,67 @@
+import time
+import unittest
+from types import SimpleNamespace
+
+from SimConnect import SimConnect, TrafficReader, TrafficTable
+
+
+def wait_for(predicate, timeout=2.0):
+	deadline = time.time() + timeout
+	while time.time() < deadline:
+		if predicate():
+			return True
+		time.sleep(.01)
+	return predicate()
+
+
+class TrafficReaderTest(unittest.TestCase):
+
+	def setUp(self):
+		self.sm = SimConnect(backend="fake")
+		self.model = self.sm.dll.model
+		# AI aircraft spawn on the user and take their orbit on the first step.
+		self.assertTrue(wait_for(lambda: self.model.clock > 0))
+
+	def tearDown(self):
+		self.sm.exit()
+
+	def test_columns_line_up_per_object(self):
+		reader = TrafficReader(self.sm, radius=200000)
+		table = reader.get(2)
+		self.assertEqual(len(table), 1 + len(self.model.traffic))
+		self.assertEqual(sorted(table.ids), list(range(1, len(self.model.traffic) + 2)))
+		for i in range(len(table)):
+			if table.ids[i] == 1:
+				continue
+			ai = self.model.traffic[table.ids[i] - 2]
+			self.assertEqual(table.alt[i], ai["alt"])
+			self.assertEqual(table.gs[i], ai["gs"])
+		self.assertEqual(table.json()[0], table.row(0))
+		self.assertEqual(set(table.row(0)), {"id"} | set(TrafficTable.columns))
+
+	def test_radius_limits_the_table(self):
+		# AI i orbits 0.05 + 0.04 * i degrees out: 3.6 to 5.6 km for the
+		# first one, at least 6.4 km for the rest.
+		reader = TrafficReader(self.sm, radius=6000)
+		self.assertEqual(sorted(reader.get(2).ids), [1, 2])
+
+	def test_radius_is_capped(self):
+		self.assertEqual(TrafficReader(self.sm, radius=10 ** 6).radius, TrafficReader.MAX_RADIUS)
+
+	def test_refresh_replaces_the_table(self):
+		reader = TrafficReader(self.sm, radius=200000)
+		first = reader.get(2)
+		second = reader.get(2)
+		self.assertIsNot(first, second)
+		self.assertEqual(reader.cycles, 2)
+		self.assertIsNone(reader.pending)
+
+	def test_empty_answer_publishes_an_empty_table(self):
+		reader = TrafficReader(self.sm)
+		reader.decode(SimpleNamespace(dwoutof=0, dwentrynumber=0))
+		self.assertEqual(len(reader.table), 0)
+		self.assertTrue(reader.updated.is_set())
+
+
+if __name__ == "__main__":
+	unittest.main()